@@ -0,0 +1,28 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef ANMS_H
+#define ANMS_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+// original suppression radius search, O(n^2). kept around as the reference
+// the benchmark compares against
+void adaptiveNonMaximalSuppresion( std::vector<cv::KeyPoint>& keypoints,
+                                    const int numToKeep );
+
+// Suppression via Square Covering (Bailo et al. 2018). Binary searches the
+// suppression width, each probe is one pass over the response sorted points
+// marking covered cells on a grid, so the whole thing is O(n log n).
+// Stops once it keeps numToKeep +- tolerance of the points and never
+// returns more than numToKeep, strongest first.
+void sscNonMaximalSuppression( std::vector<cv::KeyPoint>& keypoints,
+                               const int numToKeep, const int cols, const int rows,
+                               const float tolerance = 0.1f );
+
+#endif
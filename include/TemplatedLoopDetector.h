@@ -11,6 +11,8 @@
 #define __D_T_TEMPLATED_LOOP_DETECTOR__
 
 #include <vector>
+#include <algorithm>
+#include <functional>
 #include <numeric>
 #include <fstream>
 #include <string>
@@ -27,6 +29,8 @@
 #include "DUtilsCV/DUtilsCV.h"
 #include "DVision/DVision.h"
 
+#include "hammingKernels.h"
+
 using namespace std;
 using namespace DUtils;
 using namespace DBoW2;
@@ -133,6 +137,9 @@ public:
     int max_distance_between_groups;
     /// Max separation between two queries to consider them consistent
     int max_distance_between_queries; 
+    /// Max number of entries in the database, 0 for no limit. A full
+    /// database drops its most redundant entries, see thin()
+    int max_entries;
   
     // These are for the RANSAC to compute the F
     
@@ -265,6 +272,33 @@ public:
     const std::vector<TDescriptor> &descriptors,
     DetectionResult &match);
 
+  /**
+   * Same as above, for callers that already quantized the descriptors
+   * @param bowvec bow vector of descriptors
+   * @param featvec direct index of descriptors at di_levels, only read
+   *   when geom_check == GEOM_DI
+   */
+  bool detectLoop(const std::vector<cv::KeyPoint> &keys, 
+    const std::vector<TDescriptor> &descriptors,
+    const BowVector &bowvec, const FeatureVector &featvec,
+    DetectionResult &match);
+
+  /**
+   * Returns the parameters the detector was created with
+   */
+  inline const Parameters& getParameters() const { return m_params; }
+
+  /**
+   * Number of times the database was thinned. Entry ids change every time,
+   * getKeptEntries() maps the new ids to the ones before the last thinning
+   */
+  inline int getThinnings() const { return m_thinnings; }
+
+  /**
+   * Old id of every entry kept by the last thinning, in new id order
+   */
+  inline const std::vector<EntryId>& getKeptEntries() const { return m_kept; }
+
   /**
    * Resets the detector and clears the database, such that the next entry
    * will be 0 again
@@ -423,6 +457,15 @@ protected:
    * @param entry_id
    */
   void updateTemporalWindow(const tIsland &matched_island, EntryId entry_id);
+
+  /**
+   * Makes room in a full database by dropping a quarter of its entries, the
+   * ones most similar to the entry before them. Consecutive images of a
+   * place keep one of them, places seen once are kept. The last dislocal
+   * entries always stay. The database is rebuilt, so entry ids change and
+   * the temporal window starts over
+   */
+  void thin();
   
   /**
    * Returns the number of consistent islands in the temporal window
@@ -504,6 +547,17 @@ protected:
   /// Database
   // The loop detector stores its own copy of the database
   TemplatedDatabase<TDescriptor,F> *m_database;
+
+  /// Vocabulary the detector was created from, used to quantize the images.
+  // The database holds a sliced copy, this one keeps the overrides of a
+  // derived vocabulary (packed SIMD tree walk). It has to outlive the detector.
+  const TemplatedVocabulary<TDescriptor,F> *m_voc;
+
+  /// Vocabulary to quantize with
+  inline const TemplatedVocabulary<TDescriptor,F>* quantizer() const
+  {
+    return m_voc ? m_voc : m_database->getVocabulary();
+  }
   
   /// KeyPoints of images
   vector<vector<cv::KeyPoint> > m_image_keys;
@@ -514,6 +568,13 @@ protected:
   /// Last bow vector added to database
   BowVector m_last_bowvec;
   
+  /// Bow vectors of images, only kept when max_entries is set
+  vector<BowVector> m_image_bowvecs;
+  
+  /// Thinnings so far and the old ids the last one kept
+  int m_thinnings;
+  std::vector<EntryId> m_kept;
+  
   /// Temporal consistency window
   tTemporalWindow m_window;
   
@@ -558,6 +619,7 @@ void TemplatedLoopDetector<TDescriptor,F>::Parameters::set(float f)
   max_intragroup_gap = 3 * f;
   max_distance_between_groups = 3 * f;
   max_distance_between_queries = 2 * f; 
+  max_entries = 0;
 
   min_Fpoints = 12;
   max_ransac_iterations = 500;
@@ -572,7 +634,7 @@ void TemplatedLoopDetector<TDescriptor,F>::Parameters::set(float f)
 template<class TDescriptor, class F>
 TemplatedLoopDetector<TDescriptor,F>::TemplatedLoopDetector
   (const Parameters &params)
-  : m_database(NULL), m_params(params)
+  : m_database(NULL), m_voc(NULL), m_params(params), m_thinnings(0)
 {
 }
 
@@ -581,7 +643,7 @@ TemplatedLoopDetector<TDescriptor,F>::TemplatedLoopDetector
 template<class TDescriptor, class F>
 TemplatedLoopDetector<TDescriptor,F>::TemplatedLoopDetector
   (const TemplatedVocabulary<TDescriptor, F> &voc, const Parameters &params)
-  : m_params(params) 
+  : m_voc(&voc), m_params(params) 
 {
   m_database = new TemplatedDatabase<TDescriptor, F>(voc, 
     params.geom_check == GEOM_DI, params.di_levels);
@@ -598,6 +660,7 @@ void TemplatedLoopDetector<TDescriptor,F>::setVocabulary
   delete m_database;
   m_database = new TemplatedDatabase<TDescriptor, F>(voc, 
     m_params.geom_check == GEOM_DI, m_params.di_levels);
+  m_voc = &voc;
 }
 
 // --------------------------------------------------------------------------
@@ -605,7 +668,7 @@ void TemplatedLoopDetector<TDescriptor,F>::setVocabulary
 template<class TDescriptor, class F>
 TemplatedLoopDetector<TDescriptor, F>::TemplatedLoopDetector
   (const TemplatedDatabase<TDescriptor, F> &db, const Parameters &params)
-  : m_params(params)
+  : m_voc(NULL), m_params(params)
 {
   m_database = new TemplatedDatabase<TDescriptor, F>(db.getVocabulary(),
     params.geom_check == GEOM_DI, params.di_levels);
@@ -619,7 +682,7 @@ template<class TDescriptor, class F>
 template<class T>
 TemplatedLoopDetector<TDescriptor, F>::TemplatedLoopDetector
   (const T &db, const Parameters &params)
-  : m_params(params)
+  : m_voc(NULL), m_params(params)
 {
   m_database = new T(db);
   m_database->clear();
@@ -635,6 +698,7 @@ void TemplatedLoopDetector<TDescriptor, F>::setDatabase(const T &db)
 {
   delete m_database;
   m_database = new T(db);
+  m_voc = NULL;
   clear();
 }
 
@@ -699,17 +763,36 @@ bool TemplatedLoopDetector<TDescriptor, F>::detectLoop(
   const std::vector<TDescriptor> &descriptors,
   DetectionResult &match)
 {
-  EntryId entry_id = m_database->size();
-  match.query = entry_id;
-  
   BowVector bowvec;
   FeatureVector featvec;
   
   if(m_params.geom_check == GEOM_DI)
-    m_database->getVocabulary()->transform(descriptors, bowvec, featvec,
+    quantizer()->transform(descriptors, bowvec, featvec,
       m_params.di_levels);
   else
-    m_database->getVocabulary()->transform(descriptors, bowvec);
+    quantizer()->transform(descriptors, bowvec);
+
+  return detectLoop(keys, descriptors, bowvec, featvec, match);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedLoopDetector<TDescriptor, F>::detectLoop(
+  const std::vector<cv::KeyPoint> &keys, 
+  const std::vector<TDescriptor> &descriptors,
+  const BowVector &bowvec, const FeatureVector &featvec,
+  DetectionResult &match)
+{
+  // a full database makes room first, every image still becomes an entry
+  if(m_params.max_entries > 0 && 
+    (int)m_database->size() >= m_params.max_entries)
+  {
+    thin();
+  }
+
+  EntryId entry_id = m_database->size();
+  match.query = entry_id;
 
   if((int)entry_id <= m_params.dislocal)
   {
@@ -734,7 +817,7 @@ bool TemplatedLoopDetector<TDescriptor, F>::detectLoop(
       
       if(m_params.use_nss)
       {
-        ns_factor = m_database->getVocabulary()->score(bowvec, m_last_bowvec);
+        ns_factor = quantizer()->score(bowvec, m_last_bowvec);
       }
       
       if(!m_params.use_nss || ns_factor >= m_params.min_nss_factor)
@@ -850,6 +933,11 @@ bool TemplatedLoopDetector<TDescriptor, F>::detectLoop(
     m_image_keys[entry_id] = keys;
     m_image_descriptors[entry_id] = descriptors;
   }
+  if(m_params.max_entries > 0)
+  {
+    m_image_bowvecs.resize(entry_id + 1);
+    m_image_bowvecs[entry_id] = bowvec;
+  }
   
   // store this bowvec if we are going to use it in next iteratons
   if(m_params.use_nss && (int)entry_id + 1 > m_params.dislocal)
@@ -867,6 +955,65 @@ inline void TemplatedLoopDetector<TDescriptor, F>::clear()
 {
   m_database->clear();
   m_window.nentries = 0;
+  m_image_bowvecs.clear();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedLoopDetector<TDescriptor, F>::thin()
+{
+  const EntryId n = m_database->size();
+  const EntryId keep_last = std::max(m_params.dislocal, 1);
+  
+  // redundancy of an entry : its score against the one before it
+  vector<pair<double, EntryId> > redundancy;
+  for(EntryId i = 1; i + keep_last < n; ++i)
+  {
+    redundancy.push_back(make_pair(
+      quantizer()->score(m_image_bowvecs[i], m_image_bowvecs[i-1]), i));
+  }
+  const size_t drop = std::min((size_t)(n / 4), redundancy.size());
+  if(drop == 0) return;
+  
+  std::nth_element(redundancy.begin(), redundancy.begin() + (drop - 1),
+    redundancy.end(), std::greater<pair<double, EntryId> >());
+  vector<bool> dropped(n, false);
+  for(size_t i = 0; i < drop; ++i) dropped[redundancy[i].second] = true;
+  
+  // the direct index lives in the database only, copy it out first
+  vector<FeatureVector> featvecs;
+  if(m_params.geom_check == GEOM_DI)
+  {
+    featvecs.resize(n);
+    for(EntryId i = 0; i < n; ++i)
+      if(!dropped[i]) featvecs[i] = m_database->retrieveFeatures(i);
+  }
+  
+  m_kept.clear();
+  m_database->clear();
+  for(EntryId i = 0; i < n; ++i)
+  {
+    if(dropped[i]) continue;
+    const EntryId j = m_kept.size();
+    if(m_params.geom_check == GEOM_DI)
+      m_database->add(m_image_bowvecs[i], featvecs[i]);
+    else
+      m_database->add(m_image_bowvecs[i]);
+    if(j != i)
+    {
+      m_image_keys[j].swap(m_image_keys[i]);
+      m_image_descriptors[j].swap(m_image_descriptors[i]);
+      m_image_bowvecs[j].swap(m_image_bowvecs[i]);
+    }
+    m_kept.push_back(i);
+  }
+  m_image_keys.resize(m_kept.size());
+  m_image_descriptors.resize(m_kept.size());
+  m_image_bowvecs.resize(m_kept.size());
+  
+  m_window.nentries = 0;
+  m_thinnings++;
 }
 
 // --------------------------------------------------------------------------
@@ -1252,6 +1399,32 @@ bool TemplatedLoopDetector<TDescriptor, F>::isGeometricallyConsistent_Flann
 
 // --------------------------------------------------------------------------
 
+/// Packs the selected descriptors for the hamming kernels, false for
+/// descriptor types they don't handle
+template<class TDescriptor>
+inline bool packDescriptors(const vector<TDescriptor> &, 
+  const vector<unsigned int> &, vector<packedDescriptor> &)
+{
+  return false;
+}
+
+/// 256 bit ORB rows
+inline bool packDescriptors(const vector<cv::Mat> &D, 
+  const vector<unsigned int> &i_D, vector<packedDescriptor> &packed)
+{
+  packed.resize(i_D.size());
+  for(unsigned int i = 0; i < i_D.size(); ++i)
+  {
+    const cv::Mat &d = D[i_D[i]];
+    if(!d.isContinuous() || d.total()*d.elemSize() != sizeof(packedDescriptor))
+      return false;
+    packed[i] = packDescriptor(d.data);
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedLoopDetector<TDescriptor, F>::getMatches_neighratio(
   const vector<TDescriptor> &A, const vector<unsigned int> &i_A,
@@ -1263,6 +1436,13 @@ void TemplatedLoopDetector<TDescriptor, F>::getMatches_neighratio(
   i_match_A.reserve( min(i_A.size(), i_B.size()) );
   i_match_B.reserve( min(i_A.size(), i_B.size()) );
   
+  // binary descriptors go through the SIMD kernels, one query against all
+  // of B at once
+  vector<packedDescriptor> packed_A, packed_B;
+  const bool packed = !i_B.empty() && packDescriptors(A, i_A, packed_A) &&
+    packDescriptors(B, i_B, packed_B);
+  vector<int> dist_B(packed ? i_B.size() : 0);
+  
   vector<unsigned int>::const_iterator ait, bit;
   unsigned int i, j;
   i = 0;
@@ -1272,10 +1452,13 @@ void TemplatedLoopDetector<TDescriptor, F>::getMatches_neighratio(
     double best_dist_1 = 1e9;
     double best_dist_2 = 1e9;
     
+    if(packed)
+      hammingDistances(packed_A[i], &packed_B[0], (int)packed_B.size(), &dist_B[0]);
+    
     j = 0;
     for(bit = i_B.begin(); bit != i_B.end(); ++bit, ++j)
     {
-      double d = F::distance(A[*ait], B[*bit]);
+      double d = packed ? dist_B[j] : F::distance(A[*ait], B[*bit]);
             
       // in i
       if(d < best_dist_1)
@@ -0,0 +1,93 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef BINARY_VOCABULARY_H
+#define BINARY_VOCABULARY_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "DBoW2/DBoW2.h"
+#include "hammingKernels.h"
+
+// Flat ORB vocabulary written by vocabularyConverter:
+//   [header][node array][child ids][32 byte descriptor per child id]
+// every section starts on a 64 byte boundary. node i keeps its children at
+// children[firstChild, firstChild+nChildren) and their descriptors at the
+// same positions of the descriptor block, so the siblings compared at one
+// level of the tree walk are back to back. leaves are the words.
+#define BINARY_VOC_MAGIC "RSBINVOC"
+#define BINARY_VOC_VERSION 2
+
+struct binaryVocHeader{
+    char magic[8];
+    uint32_t version;
+    int32_t k, L, weighting, scoring;
+    uint32_t nNodes, nWords, nChildren, descBytes;
+    uint64_t nodesOffset, childrenOffset, descOffset;
+};
+
+struct binaryVocNode{
+    double weight;
+    int32_t parent;
+    int32_t wordId;
+    uint32_t firstChild, nChildren;
+};
+
+// OrbVocabulary that loads from a read only shared mapping of the binary
+// file. node descriptors are cv::Mat views into the mapping, so nothing is
+// parsed or copied and every process using the same file shares its pages.
+// The loop detector database copies the vocabulary as a plain OrbVocabulary,
+// those copies keep pointing into the mapping, which is why mappings are
+// kept until the process exits (and reused when a file is loaded again).
+//
+// Once loaded (or pack()ed after a YAML load / create()) the tree walk
+// compares a query against all children of a node at once with the hamming
+// kernels instead of one FORB::distance per child.
+class binaryOrbVocabulary : public OrbVocabulary{
+    public:
+        binaryOrbVocabulary(){}
+        binaryOrbVocabulary(const binaryOrbVocabulary&) = delete;
+        binaryOrbVocabulary& operator=(const binaryOrbVocabulary&) = delete;
+
+        bool loadBinary(const std::string &path);
+        // the vocabulary as it is now, typically right after a YAML load()
+        bool saveBinary(const std::string &path) const;
+        // builds the packed layout in memory for a vocabulary that did not
+        // come from a binary file
+        bool pack();
+        bool packed() const { return flatNodes!=NULL; }
+
+        using OrbVocabulary::transform;
+
+    protected:
+        void transform(const DBoW2::FORB::TDescriptor &feature, DBoW2::WordId &id,
+                       DBoW2::WordValue &weight, DBoW2::NodeId *nid = NULL, int levelsup = 0) const;
+        // leaf node q ends up in, needs the packed layout
+        uint32_t walk(const packedDescriptor &q, DBoW2::NodeId *nid = NULL, int levelsup = 0) const;
+
+    private:
+        const binaryVocNode *flatNodes = NULL;
+        const uint32_t *flatChildren = NULL;
+        const packedDescriptor *flatDesc = NULL;
+        // backing store when pack()ed
+        std::vector<binaryVocNode> ownNodes;
+        std::vector<uint32_t> ownChildren;
+        std::vector<packedDescriptor> ownDesc;
+
+        bool flatten(std::vector<binaryVocNode> &nodes, std::vector<uint32_t> &children,
+                     std::vector<packedDescriptor> &desc) const;
+};
+
+// true when the file starts with the binary vocabulary magic
+bool isBinaryVocabulary(const std::string &path);
+// binary or DBoW2 YAML (.yml/.yml.gz) depending on the file, nullptr with the
+// reason on stderr when it could not be read
+std::shared_ptr<OrbVocabulary> loadOrbVocabulary(const std::string &path);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef COMPACTION_H
+#define COMPACTION_H
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+// Stable in place filtering of parallel arrays : element i of every array is
+// kept where keep[i] is non zero, order is preserved and nothing is
+// reallocated (resize down keeps the capacity). Every array has to be exactly
+// as long as the mask, which is what keeps the indexing in bounds.
+//
+//   compactByMask(status, refPts, trkPts, pts3d);
+
+namespace compaction{
+    template<class M, class T>
+    void compactOne(const std::vector<M> &keep, std::vector<T> &a){
+        assert(a.size()==keep.size());
+        const size_t n = keep.size()<a.size() ? keep.size() : a.size();
+        size_t w = 0;
+        for(size_t i=0; i<n; i++){
+            if(keep[i]){
+                if(w!=i){
+                    a[w] = std::move(a[i]);
+                }
+                w++;
+            }
+        }
+        a.resize(w);
+    }
+
+    template<class M>
+    void compactEach(const std::vector<M>&){}
+
+    template<class M, class T, class... Rest>
+    void compactEach(const std::vector<M> &keep, std::vector<T> &a, Rest&... rest){
+        compactOne(keep, a);
+        compactEach(keep, rest...);
+    }
+}
+
+// returns how many elements survived
+template<class M, class... Arrays>
+size_t compactByMask(const std::vector<M> &keep, Arrays&... arrays){
+    compaction::compactEach(keep, arrays...);
+    size_t n = 0;
+    for(size_t i=0; i<keep.size(); i++){
+        n += keep[i] ? 1 : 0;
+    }
+    return n;
+}
+
+#endif
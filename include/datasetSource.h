@@ -0,0 +1,161 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef DATASET_SOURCE_H
+#define DATASET_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+
+#include "framePrefetcher.h"
+#include "frameCache.h"
+
+// rectified pair, right camera at +baseline on x. zeros until known
+struct stereoCalibration{
+    double fx = 0, fy = 0, cx = 0, cy = 0, baseline = 0;
+
+    bool valid() const { return fx>0 && fy>0 && baseline>0; }
+    cv::Mat K() const { return (cv::Mat1d(3,3) << fx, 0, cx, 0, fy, cy, 0, 0, 1); }
+    // P0/P1 (gray) or P2/P3 of a KITTI calib.txt, untouched when missing.
+    // inline so tools can read one without linking the ROS side
+    inline bool readKitti(const std::string &calibFile, bool gray);
+};
+
+// "Pn: 12 numbers" rows of a KITTI calib.txt
+inline bool readKittiProjection(const std::string &calibFile, const std::string &name, double P[12]){
+    std::ifstream in(calibFile);
+    std::string line;
+    while(std::getline(in, line)){
+        if(line.compare(0, name.size()+1, name + ":")!=0){
+            continue;
+        }
+        std::istringstream ss(line.substr(name.size()+1));
+        for(int j=0; j<12; j++){
+            if(!(ss>>P[j])){
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+inline bool stereoCalibration::readKitti(const std::string &calibFile, bool gray){
+    double PL[12], PR[12];
+    if(!readKittiProjection(calibFile, gray ? "P0" : "P2", PL) ||
+       !readKittiProjection(calibFile, gray ? "P1" : "P3", PR) || PL[0]<=0){
+        return false;
+    }
+    fx = PL[0]; cx = PL[2];
+    fy = PL[5]; cy = PL[6];
+    // P(0,3) = -fx*x of the camera centre
+    baseline = (PL[3] - PR[3])/PL[0];
+    return true;
+}
+
+// Where stereo pairs come from. Everything that describes the sequence
+// (length, timestamps, calibration, ground truth) is read once when the
+// source is opened, load() only fetches pixels and has to be safe to call
+// from the prefetcher's decode threads.
+class datasetSource{
+    public:
+        virtual ~datasetSource(){}
+
+        // fills imL/imR of frame idx, false past the end or on a read error.
+        // with lazyRight set imR may be left empty, see loadRight()
+        virtual bool load(int idx, stereoFrame &frame) = 0;
+        // fills imR of a frame load() left it out of
+        virtual bool loadRight(int idx, stereoFrame &frame);
+        // frame count, -1 for live sources that run until shut down
+        virtual int size() const = 0;
+        virtual std::string describe() const = 0;
+        // seconds since the first frame
+        virtual double timestamp(int idx) const;
+        // size() cut down to frameLimit, what a run should go through
+        int length() const;
+
+        bool hasGroundTruth() const { return !groundTruth.empty(); }
+        // camera->world pose of the left camera, KITTI convention
+        bool groundTruthPose(int idx, cv::Matx34d &pose) const;
+        // distance travelled between idx-1 and idx according to ground truth,
+        // 0 when there is none
+        double groundTruthScale(int idx) const;
+        bool loadGroundTruth(const std::string &posesFile);
+
+        stereoCalibration calib;
+        // fallback when there are no timestamps
+        double frameRate = 10.0;
+        // the tracker only needs luma from the right camera, sources that
+        // decode can skip the colour conversion
+        bool lumaRight = false;
+        // the tracker only needs the right image on keyframes, sources that
+        // decode can put it off until loadRight() is called
+        bool lazyRight = false;
+        int frameLimit = -1;
+
+    protected:
+        std::vector<double> times;
+        std::vector<cv::Matx34d> groundTruth;
+};
+
+// KITTI odometry sequence directory : image_2/image_3 (image_0/image_1 when
+// gray), calib.txt and times.txt. ground truth is a separate poses/XX.txt
+class kittiSource : public datasetSource{
+    public:
+        explicit kittiSource(const std::string &sequenceDir, bool gray = false);
+
+        bool load(int idx, stereoFrame &frame);
+        bool loadRight(int idx, stereoFrame &frame);
+        int size() const { return nFrames; }
+        std::string describe() const;
+
+    private:
+        std::string dir, leftDir, rightDir;
+        int nFrames = 0;
+
+        std::string imagePath(const std::string &camDir, int idx) const;
+};
+
+// packed replay file written by frameCacheConverter
+class frameCacheSource : public datasetSource{
+    public:
+        bool open(const std::string &path);
+
+        bool load(int idx, stereoFrame &frame);
+        int size() const { return reader.size(); }
+        std::string describe() const { return "frame cache " + path; }
+
+    private:
+        frameCacheReader reader;
+        std::string path;
+};
+
+// what the executables take on the command line
+struct datasetOptions{
+    std::string kittiDir;
+    std::string cacheFile;
+    std::string leftTopic, rightTopic;
+    std::string leftInfoTopic, rightInfoTopic;
+    std::string posesFile;
+    std::string vocabulary;
+    bool gray = false;
+    // stop after this many frames, -1 runs the whole sequence
+    int maxFrames = -1;
+};
+
+void printDatasetUsage(const char *prog);
+// false on unknown flags or a missing value. a bare first argument is taken
+// as a KITTI directory or, when it is a file, a frame cache
+bool parseDatasetArgs(int argc, char **argv, datasetOptions &opt);
+// nullptr (with the reason on stderr) when nothing could be opened
+std::shared_ptr<datasetSource> openDataset(const datasetOptions &opt);
+
+#endif
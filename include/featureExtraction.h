@@ -0,0 +1,68 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef FEATURE_EXTRACTION_H
+#define FEATURE_EXTRACTION_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "threadPool.h"
+#include "ANMS.h"
+
+struct bucketParams{
+    int cellSize = 40;
+    // hard cap per cell and for the whole image
+    int perCellCap = 6;
+    int totalBudget = 1200;
+    int fastThreshold = 12;
+    // rescore FAST corners with the min eigenvalue of the structure tensor
+    bool shiTomasi = false;
+    // keep corners away from the edges, LK windows need the room
+    int border = 20;
+    // skip the grid and pick totalBudget corners with SSC suppression instead
+    bool useAnms = false;
+};
+
+// Owns every detector/matcher the tracker needs so they get built once per
+// run instead of once per frame, along with the scratch buffers they fill.
+class featureExtractor{
+    public:
+        featureExtractor(int nStereoFeatures = 1000);
+
+        // ORB for place recognition. desc is written fresh every call because
+        // the loop detector keeps row headers into it. shares nothing with the
+        // stereo side, so the loop stage can run it next to the tracker
+        void extractLoopFeatures(const cv::Mat &img, std::vector<cv::KeyPoint> &kp, cv::Mat &desc);
+
+        // corners spread over a grid : every cell hands out its best corner per
+        // round until the budget runs out, so textured cells soak up what
+        // sky and road leave unused but never go past perCellCap
+        void bucketedKeypoints(const cv::Mat &gray, std::vector<cv::Point2f> &pts, const bucketParams &params);
+
+        // sparse stereo path : ORB on both images in parallel + ratio test
+        void matchStereo(const cv::Mat &imL, const cv::Mat &imR,
+                         std::vector<cv::Point2f> &pt1, std::vector<cv::Point2f> &pt2, float ratio = 0.8f);
+
+    private:
+        cv::Ptr<cv::ORB> loopOrb;
+        cv::Ptr<cv::ORB> stereoOrbL, stereoOrbR;
+        cv::Ptr<cv::DescriptorMatcher> matcher;
+        threadPool rightWorker;
+
+        std::vector<cv::KeyPoint> kpL, kpR;
+        cv::Mat descL, descR;
+        std::vector<std::vector<cv::DMatch>> knn;
+
+        std::vector<cv::KeyPoint> corners;
+        std::vector<std::vector<int>> cells;
+        std::vector<int> roundIdx;
+        cv::Mat eig, lumaScratch;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+#include "framePrefetcher.h"
+
+// Packed stereo replay file:
+//   [header][page aligned raw left/right planes ...][frame index]
+// the index sits at the end so the converter can stream frames in.
+#define FRAME_CACHE_MAGIC "RSFCACHE"
+#define FRAME_CACHE_VERSION 1
+
+struct frameCacheHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t nFrames;
+    uint64_t pageSize;
+    uint64_t indexOffset;
+    // calibration of the rectified pair, 0 if unknown
+    double fx, fy, cx, cy, baseline;
+};
+
+struct frameCacheEntry{
+    uint64_t offset[2];
+    int32_t rows[2], cols[2], type[2];
+};
+
+class frameCacheWriter{
+    public:
+        ~frameCacheWriter();
+
+        bool open(const std::string &path, int pageSize = 4096);
+        void setCalibration(double fx, double fy, double cx, double cy, double baseline);
+        bool append(const cv::Mat &imL, const cv::Mat &imR);
+        bool close();
+
+    private:
+        FILE *fp = NULL;
+        frameCacheHeader header = frameCacheHeader();
+        std::vector<frameCacheEntry> index;
+        uint64_t cursor = 0;
+
+        bool writePlane(const cv::Mat &im, uint64_t &offset);
+        bool padToPage();
+};
+
+// Memory maps a cache file and hands out cv::Mat views straight into the
+// mapping, nothing is copied or decoded. The views are only valid while the
+// reader is alive; the mapping is private so stray writes never reach disk.
+class frameCacheReader{
+    public:
+        ~frameCacheReader();
+
+        bool open(const std::string &path);
+        void close();
+        bool getFrame(int idx, stereoFrame &frame) const;
+        void prefetch(int idx) const;
+
+        int size() const { return (int)header.nFrames; }
+        const frameCacheHeader& info() const { return header; }
+
+    private:
+        unsigned char *base = NULL;
+        size_t mappedBytes = 0;
+        frameCacheHeader header = frameCacheHeader();
+        const frameCacheEntry *index = NULL;
+
+        // byte length of plane v of e, 0 when the entry points outside the
+        // mapping (truncated or corrupt file)
+        uint64_t planeBytes(const frameCacheEntry &e, int v) const;
+};
+
+#endif
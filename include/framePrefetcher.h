@@ -0,0 +1,59 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef FRAME_PREFETCHER_H
+#define FRAME_PREFETCHER_H
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <future>
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+#include "threadPool.h"
+
+struct stereoFrame{
+    int idx = -1;
+    cv::Mat imL, imR;
+    // planes the tracker works on, 8 bit luma or aliases of imL/imR
+    cv::Mat grayL, grayR;
+    // LK pyramids of grayL/grayR, built once and shared by every tracker
+    std::vector<cv::Mat> pyrL, pyrR;
+};
+
+typedef std::function<bool(int, stereoFrame&)> frameLoader;
+
+// Keeps a bounded window of stereo pairs decoding ahead of the tracker.
+// getFrame() is meant to be called from a single consumer thread with
+// (mostly) increasing indices, every frame is decoded once.
+class framePrefetcher{
+    public:
+        framePrefetcher(frameLoader loader, int lookahead = 8, int nThreads = 2);
+
+        void start(int firstIdx, int endIdx = -1);
+        bool getFrame(int idx, stereoFrame &frame);
+        int queueDepth() const { return (int)pending.size(); }
+
+    private:
+        struct pendingFrame{
+            std::shared_ptr<stereoFrame> frame;
+            std::future<bool> ready;
+        };
+
+        frameLoader load;
+        int lookahead;
+        int nextIdx = 0;
+        int endIdx = -1;
+
+        std::map<int, pendingFrame> pending;
+        threadPool decodePool;
+
+        void schedule(int idx);
+};
+
+#endif
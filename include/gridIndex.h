@@ -0,0 +1,58 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef GRID_INDEX_H
+#define GRID_INDEX_H
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+// Spatial hash over 2D features for fixed radius queries. Points are bucketed
+// into square cells of side cellSize, cells are hashed into a power of two
+// table and stored CSR style (one offset per bucket, point indices sorted by
+// bucket), so build is two linear passes and a query only walks the 3x3 cells
+// around it as long as radius<=cellSize. Collisions only cost a few extra
+// distance tests, results are exact.
+class gridIndex{
+    public:
+        explicit gridIndex(float cellSize = 10.0f) : cell(cellSize) {}
+
+        void setCellSize(float cellSize){ cell = cellSize; }
+        float cellSize() const { return cell; }
+
+        // indexes pts, or only pts[subset[k]] when subset is given. indices
+        // handed back by the queries always refer to pts. pts is not copied,
+        // clear() the index before pts is resized or goes away
+        void build(const std::vector<cv::Point2f> &pts);
+        void build(const std::vector<cv::Point2f> &pts, const std::vector<int> &subset);
+        void clear();
+
+        size_t size() const { return order.size(); }
+        bool empty() const { return order.empty(); }
+
+        // true if any indexed point is strictly closer than radius to p
+        bool anyWithin(const cv::Point2f &p, float radius) const;
+        // every indexed point strictly closer than radius to p, unordered
+        void radiusQuery(const cv::Point2f &p, float radius, std::vector<int> &out) const;
+
+    private:
+        float cell;
+        float invCell = 0.1f;
+        uint32_t tableMask = 0;
+        const std::vector<cv::Point2f> *src = nullptr;
+        // bucket b holds order[start[b] .. start[b+1])
+        std::vector<int> start;
+        std::vector<int> order;
+        std::vector<uint32_t> keys;
+
+        inline int cellOf(float v) const;
+        inline uint32_t bucketOf(int cx, int cy) const;
+        void buildFrom(const std::vector<cv::Point2f> &pts, const int *subset, size_t n);
+};
+
+#endif
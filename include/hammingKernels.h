@@ -0,0 +1,38 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef HAMMING_KERNELS_H
+#define HAMMING_KERNELS_H
+
+#include <array>
+#include <cstring>
+#include <stdint.h>
+
+// 256 bit ORB descriptor as four words, what the kernels below work on
+typedef std::array<uint64_t, 4> packedDescriptor;
+
+inline packedDescriptor packDescriptor(const unsigned char *bytes){
+    packedDescriptor d;
+    memcpy(d.data(), bytes, sizeof(d));
+    return d;
+}
+
+inline int hammingDistance(const packedDescriptor &a, const packedDescriptor &b){
+    return __builtin_popcountll(a[0]^b[0]) + __builtin_popcountll(a[1]^b[1]) +
+           __builtin_popcountll(a[2]^b[2]) + __builtin_popcountll(a[3]^b[3]);
+}
+
+// distance from q to each of the n candidates stored back to back
+void hammingDistances(const packedDescriptor &q, const packedDescriptor *cands, int n, int *dist);
+
+// index of the first closest candidate (ties keep the lower index, like the
+// DBoW2 tree walk), its distance goes to bestDist when given. n>0
+int nearestHamming(const packedDescriptor &q, const packedDescriptor *cands, int n, int *bestDist = NULL);
+
+// name of the code path the kernels run, x86 picks it from the cpu at load time
+const char* hammingKernelISA();
+
+#endif
@@ -0,0 +1,84 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef KEYFRAME_POLICY_H
+#define KEYFRAME_POLICY_H
+
+enum keyFrameReason{
+    KF_NONE = 0,
+    KF_FORCED,
+    KF_INLIERS,
+    KF_SURVIVAL,
+    KF_COVISIBILITY,
+    KF_PARALLAX,
+    KF_TIME,
+    KF_DISTANCE,
+    KF_REASONS
+};
+
+const char* keyFrameReasonName(keyFrameReason r);
+
+// what the tracker knows about the current frame relative to the last keyframe
+struct keyFrameSignals{
+    int frame = 0;
+    int framesSince = 0;
+    // PnP inliers of this frame
+    int inliers = 0;
+    // tracks the last keyframe left the tracker with, and how many of them
+    // LK still follows
+    int trackedAtKeyFrame = 0;
+    int tracked = 0;
+    // tracks of the keyframe that are also PnP inliers now
+    int covisible = 0;
+    // median pixel displacement of the tracks since the keyframe
+    float parallax = 0;
+    // seconds, metres and radians since the keyframe
+    double elapsed = 0;
+    double distance = 0;
+    double rotation = 0;
+};
+
+// decides when the tracker should triangulate a new keyframe. the tracker
+// owns one through a shared_ptr, swap it for a different strategy
+class keyFramePolicy{
+    public:
+        virtual ~keyFramePolicy(){}
+        virtual keyFrameReason decide(const keyFrameSignals &s) = 0;
+};
+
+// the original rule, a keyframe whenever PnP keeps fewer than minInliers
+class inlierKeyFramePolicy : public keyFramePolicy{
+    public:
+        explicit inlierKeyFramePolicy(int minInliers = 200) : minInliers(minInliers) {}
+        keyFrameReason decide(const keyFrameSignals &s);
+
+        int minInliers;
+};
+
+struct keyFramePolicyParams{
+    // hard floor, fires regardless of minFrames
+    int minInliers = 120;
+    // no soft trigger this soon after a keyframe
+    int minFrames = 2;
+    float minSurvival = 0.5f;
+    float minCovisibility = 0.35f;
+    float maxParallax = 40.0f;
+    double maxElapsed = 2.0;
+    double maxDistance = 2.5;
+    double maxRotation = 0.3;
+};
+
+// keyframes from track health and motion : the first signal past its limit
+// wins, checked in the order the reasons are listed
+class multiCueKeyFramePolicy : public keyFramePolicy{
+    public:
+        explicit multiCueKeyFramePolicy(const keyFramePolicyParams &p = keyFramePolicyParams()) : params(p) {}
+        keyFrameReason decide(const keyFrameSignals &s);
+
+        keyFramePolicyParams params;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef KEYFRAME_STORE_H
+#define KEYFRAME_STORE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdio>
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+// one per keyframe : the pose it was triangulated at and the points it added,
+// in its camera frame, so a new pose re-places them. rgb is empty or one
+// colour per point
+struct keyFrame{
+    int idx = -1;
+    // pose graph vertex, the graph gets one per keyframe
+    int vertex = -1;
+    cv::Mat R,t;
+    std::vector<cv::Point3f> ref3dCoords;
+    std::vector<uint32_t> rgb;
+};
+
+// Every keyframe of the run. Poses always stay in RAM, the point clouds only
+// up to budgetBytes : past that the least recently used ones are written to
+// an append only spill file (once, clouds never change after add) and
+// dropped, cloud() reads them back when somebody needs them again.
+// Not thread safe, visualSLAM only touches it under renderMutex.
+class keyFrameStore{
+    public:
+        keyFrameStore(size_t budgetBytes = 256u<<20, const std::string &spillPath = "keyframes.spill");
+        ~keyFrameStore();
+
+        void setBudget(size_t budgetBytes);
+        // only before the first spill
+        void setSpillPath(const std::string &path);
+
+        // takes kf.ref3dCoords and kf.rgb, returns the keyframe's index
+        size_t add(keyFrame &kf);
+        size_t size() const { return entries.size(); }
+        bool empty() const { return entries.empty(); }
+
+        // pose part, ref3dCoords and rgb of it may be empty when the cloud is
+        // on disk
+        keyFrame& meta(size_t k){ return entries[k].kf; }
+        keyFrame& back(){ return entries.back().kf; }
+        // the cloud, faulted back in with its colours (meta(k).rgb) if it
+        // was spilled. the reference holds until the next call into the store
+        const std::vector<cv::Point3f>& cloud(size_t k);
+        bool resident(size_t k) const { return entries[k].resident; }
+
+        size_t residentBytes() const { return inRam; }
+        size_t spilledBytes() const { return onDisk; }
+        long faults = 0, evictions = 0;
+
+    private:
+        struct entry{
+            keyFrame kf;
+            bool resident = true;
+            // where the cloud sits in the spill file, -1 until written
+            int64_t offset = -1;
+            uint32_t count = 0, rgbCount = 0;
+            std::list<size_t>::iterator lruPos;
+        };
+
+        std::vector<entry> entries;
+        // resident entries, most recently used first
+        std::list<size_t> lru;
+        size_t budget;
+        size_t inRam = 0, onDisk = 0;
+        std::string path;
+        FILE *fp = NULL;
+
+        void touch(size_t k);
+        static size_t bytes(const entry &e);
+        void enforceBudget();
+        bool spill(entry &e);
+};
+
+// drops the oldest elements once v grows a bit past window, a few at a time
+// so the erase cost is spread out. returns how many went
+template<class T>
+size_t trimToWindow(std::vector<T> &v, size_t window){
+    if(window==0 || v.size()<=window + window/8){
+        return 0;
+    }
+    const size_t drop = v.size() - window;
+    v.erase(v.begin(), v.begin() + drop);
+    return drop;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef LANDMARK_TABLE_H
+#define LANDMARK_TABLE_H
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+#include "compaction.h"
+
+// colours are stored the way pcl::PointXYZRGB packs them, 0x00RRGGBB
+inline uint32_t packRGB(uchar r, uchar g, uchar b){
+    return ((uint32_t)r<<16) | ((uint32_t)g<<8) | (uint32_t)b;
+}
+inline uchar redOf(uint32_t c){ return (c>>16) & 0xff; }
+inline uchar greenOf(uint32_t c){ return (c>>8) & 0xff; }
+inline uchar blueOf(uint32_t c){ return c & 0xff; }
+
+// where the live tracks sat in one keyframe, by id so it stays valid while
+// rows move around
+struct trackObservations{
+    int frame;
+    std::vector<int> id;
+    std::vector<cv::Point2f> uv;
+};
+
+// Every live landmark of the tracker, one row per point, one column per
+// attribute. xyz/uv are plain Point3f/Point2f vectors so OpenCV (LK, PnP)
+// takes them as they are. Rows move around (compaction, swap remove) but a
+// point's id never changes, slotOf() finds it again.
+class landmarkTable{
+    public:
+        std::vector<cv::Point3f> xyz;
+        std::vector<cv::Point2f> uv;
+        std::vector<uint32_t> rgb;
+        std::vector<int> id;
+        // frames since the point was created, and frames it was seen in
+        std::vector<int> age;
+        std::vector<int> nObs;
+
+        // observations of the last historyWindow keyframes, oldest first
+        std::deque<trackObservations> history;
+        size_t historyWindow = 10;
+
+        size_t size() const { return id.size(); }
+        bool empty() const { return id.empty(); }
+
+        void reserve(size_t n);
+        // drops every row, ids are not reused
+        void clear();
+
+        // returns the new point's id
+        int add(const cv::Point3f &p, const cv::Point2f &obs, uint32_t colour);
+        // current row of a point, -1 once it has been removed
+        int slotOf(int pointId) const;
+
+        // O(1) removal, the last row takes the freed slot
+        void swapRemove(size_t slot);
+
+        // stable removal of every row with keep[i]==0, order is kept
+        template<class M>
+        size_t compact(const std::vector<M> &keep){
+            for(size_t i=0; i<keep.size() && i<id.size(); i++){
+                if(!keep[i]){
+                    slots.erase(id[i]);
+                }
+            }
+            size_t n = compactByMask(keep, xyz, uv, rgb, id, age, nObs);
+            for(size_t i=0; i<id.size(); i++){
+                slots[id[i]] = (int)i;
+            }
+            return n;
+        }
+
+        // one more frame went by and every remaining row was observed in it
+        void markTracked();
+        // snapshots uv of every row as seen in keyframe frame
+        void recordObservations(int frame);
+
+    private:
+        // id -> row of the live points only, so it never holds more entries
+        // than the table has rows however many ids were handed out
+        std::unordered_map<int,int> slots;
+        int nextId = 0;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include "poseGraph.h"
 #include "DloopDet.h"
 #include "TemplatedLoopDetector.h"
+#include "binaryVocabulary.h"
 
 using namespace cv;
 using namespace std;
@@ -47,9 +48,11 @@ class templatedLoopDetector{
         param.geom_check = GEOM_DI;
         param.di_levels = 2; 
 
-        voc.reset(new OrbVocabulary());
         cerr<<"Loading vocabulary..."<<endl;
-        voc->load(vocfile);
+        voc = loadOrbVocabulary(vocfile);
+        if(!voc){
+            voc.reset(new OrbVocabulary());
+        }
         cerr<<"Done"<<endl;
 
         loopDetector.reset(new OrbLoopDetector(*voc, param));
@@ -8,6 +8,7 @@ buncha utility functions to clean up base CXX files
 
 #include "poseGraph.h"
 #include "DloopDet.h"
+#include "gridIndex.h"
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -127,36 +128,6 @@ cv::Mat Eigen2cvMat(const Eigen::Isometry3d& matrix) {
 }
 
 
-double getAbsoluteScale(int frame_id, double &Xpos, double &Ypos, double &Zpos){  
-    string line;
-    int i = 0;
-    ifstream myfile ("/media/gautham/Seagate Backup Plus Drive/Datasets/dataset/poses/00.txt");
-    double x =0, y=0, z = 0;
-    double x_prev, y_prev, z_prev;
-    if (myfile.is_open()){
-        while (( getline (myfile,line) ) && (i<=frame_id)){
-            z_prev = z;
-            x_prev = x;
-            y_prev = y;
-            std::istringstream in(line);
-            for (int j=0; j<12; j++)  {
-                in >> z ;
-                if (j==7) y=z;
-                if (j==3)  x=z;
-            }
-            i++;
-        }
-        myfile.close();
-    }
-
-    else {
-        cout << "Unable to open file";
-        return 0;
-    }
-    Xpos = x_prev; Ypos = y_prev; Zpos = z_prev;
-    return sqrt((x-x_prev)*(x-x_prev) + (y-y_prev)*(y-y_prev) + (z-z_prev)*(z-z_prev)) ;
-}
-
 Mat drawDeltas(Mat im, vector<Point2f> in1, vector<Point2f> in2){
     Mat frame;
     im.copyTo(frame);
@@ -192,22 +163,17 @@ void getColors(Mat& img, vector<Point2f> pts,vector<Point3f>&colorMap){
     }
 }
 
+// indices of the new features with no masked base feature closer than radius,
+// the base set is hashed once so this stays linear in both sizes
 vector<int> removeDuplicates(vector<Point2f>&baseref2dFeatures, vector<Point2f>&newref2dFeatures,
                                     vector<int>&mask, int radius=10){
     vector<int> res;
+    gridIndex index((float)radius);
+    index.build(baseref2dFeatures, mask);
     for(int i=0; i<newref2dFeatures.size(); i++){
-        Point2f&p2 = newref2dFeatures[i];
-        bool inRange=false;
-        
-        for(auto j:mask){
-            Point2f&p1 = baseref2dFeatures[j];
-            if(norm(p1-p2)<radius){
-                inRange=true;
-                break;
-            }
+        if(!index.anyWithin(newref2dFeatures[i], (float)radius)){
+            res.push_back(i);
         }
-
-        if(!inRange){res.push_back(i);}
     }
     return res;
 }
@@ -0,0 +1,46 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef MOTION_MODEL_H
+#define MOTION_MODEL_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+// Constant velocity prior on the world->camera pose (the rvec/tvec solvePnP
+// works with). The last inter-frame motion is replayed, scaled by decay per
+// frame : 1 keeps the velocity, <1 leans towards standing still.
+class motionModel{
+    public:
+        motionModel(double decay = 1.0);
+
+        // true once two poses have been seen since the last reset
+        bool ready() const;
+        void predict(cv::Mat &rvec, cv::Mat &tvec) const;
+        void update(const cv::Mat &rvec, const cv::Mat &tvec);
+        void reset();
+        // the world moved, x_new = R*x_old + t. only the last pose changes,
+        // the inter-frame motion is the same in either world
+        void rebase(const cv::Mat &R, const cv::Mat &t);
+
+        double decay;
+
+    private:
+        cv::Mat lastR, lastT;
+        // last inter-frame motion, R_k * R_k-1^T and t_k - dR * t_k-1
+        cv::Mat velRvec, velT;
+        int seen = 0;
+};
+
+// pinhole projection of world points under a world->camera pose. points
+// behind the camera or outside the image keep the fallback location and get
+// valid = 0
+void projectWithPose(const std::vector<cv::Point3f> &pts3d, const cv::Mat &rvec, const cv::Mat &tvec,
+                     const cv::Mat &K, const cv::Size &imSize, const std::vector<cv::Point2f> &fallback,
+                     std::vector<cv::Point2f> &proj, std::vector<uchar> &valid);
+
+#endif
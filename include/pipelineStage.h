@@ -0,0 +1,138 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef PIPELINE_STAGE_H
+#define PIPELINE_STAGE_H
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+#include "spscQueue.h"
+
+// counters a stage keeps about itself, safe to read from any thread
+struct stageStats{
+    std::atomic<long> processed{0};
+    std::atomic<long> dropped{0};
+    std::atomic<long> busyNanos{0};
+    std::atomic<long> maxDepth{0};
+    std::atomic<long> depth{0};
+
+    // jobs per second of actual work, ignores time spent idle
+    double throughput() const{
+        long ns = busyNanos;
+        return ns>0 ? processed*1e9/ns : 0.0;
+    }
+};
+
+// one worker thread fed by an spscQueue. push() comes from exactly one thread
+// (the tracker), the handler runs on the worker. with latestOnly set the
+// worker skips straight to the newest job, which suits display/publishing
+// where stale frames are worthless.
+template<class T>
+class pipelineStage{
+    public:
+        typedef std::function<void(T&)> handlerType;
+
+        pipelineStage(handlerType handler, size_t capacity = 64, bool latestOnly = false)
+            : handler(handler), queue(capacity), latestOnly(latestOnly){}
+
+        ~pipelineStage(){
+            stop();
+        }
+
+        void start(){
+            if(worker.joinable()){
+                return;
+            }
+            stopFlag = false;
+            worker = std::thread([this](){ run(); });
+        }
+
+        // waits for the queue to drain before joining
+        void stop(){
+            stopFlag = true;
+            if(worker.joinable()){
+                worker.join();
+            }
+        }
+
+        // spins until there is room, keeps every job
+        void push(T item){
+            while(!queue.tryPush(std::move(item))){
+                std::this_thread::yield();
+            }
+            noteDepth();
+        }
+
+        // never waits, the job is counted as dropped when the queue is full
+        bool tryPush(T item){
+            if(!queue.tryPush(std::move(item))){
+                stats.dropped++;
+                return false;
+            }
+            noteDepth();
+            return true;
+        }
+
+        // tryPush that leaves the job with the caller when the queue is full,
+        // for callers that fold it into a later job instead of dropping it
+        bool tryHandOff(T &item){
+            if(!queue.tryPush(std::move(item))){
+                return false;
+            }
+            noteDepth();
+            return true;
+        }
+
+        size_t depth() const{
+            return queue.size();
+        }
+
+        stageStats stats;
+
+    private:
+        handlerType handler;
+        spscQueue<T> queue;
+        bool latestOnly;
+        std::atomic<bool> stopFlag{false};
+        std::thread worker;
+
+        void noteDepth(){
+            long d = (long)queue.size();
+            stats.depth = d;
+            if(d>stats.maxDepth){
+                stats.maxDepth = d;
+            }
+        }
+
+        void run(){
+            T item;
+            while(true){
+                if(!queue.tryPop(item)){
+                    if(stopFlag){
+                        return;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    continue;
+                }
+                if(latestOnly){
+                    while(queue.tryPop(item)){
+                        stats.dropped++;
+                    }
+                }
+                stats.depth = (long)queue.size();
+                auto t0 = std::chrono::steady_clock::now();
+                handler(item);
+                auto t1 = std::chrono::steady_clock::now();
+                stats.busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count();
+                stats.processed++;
+            }
+        }
+};
+
+#endif
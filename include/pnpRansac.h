@@ -0,0 +1,67 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef PNP_RANSAC_H
+#define PNP_RANSAC_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "stereoKernels.h"
+
+struct pnpRansacParams{
+    // px, same meaning as solvePnPRansac's reprojectionError
+    float reprojThreshold = 1.0f;
+    double confidence = 0.99;
+    // hard cap, the adaptive count usually stops far below it
+    int maxIterations = 200;
+    // T(d,d) pre-test : a hypothesis has to explain d random points before
+    // it gets scored on the whole set
+    int preTestPoints = 1;
+    // full scoring gives up on a hypothesis once it can't beat the best one,
+    // checked every scoreBlock points
+    int scoreBlock = 128;
+    bool refine = true;
+};
+
+// what the last solve() went through
+struct pnpRansacStats{
+    int hypotheses = 0;
+    int minimalFailures = 0;
+    int preRejected = 0;
+    int bailedOut = 0;
+    int fullyScored = 0;
+    int iterationBudget = 0;
+    int inliers = 0;
+};
+
+// P3P RANSAC over world->camera pose with adaptive iteration count, T(d,d)
+// pre-verification and SIMD scoring over structure of arrays buffers, LM
+// refinement on the final inlier set. Buffers are kept between calls.
+class pnpRansac{
+    public:
+        pnpRansacParams params;
+        pnpRansacStats stats;
+
+        pnpRansac(const pnpRansacParams &params = pnpRansacParams());
+
+        // rvec/tvec come back as 3x1 CV_64F, inliers index into pts3d/pts2d
+        bool solve(const std::vector<cv::Point3f> &pts3d, const std::vector<cv::Point2f> &pts2d,
+                   const cv::Mat &K, cv::Mat &rvec, cv::Mat &tvec, std::vector<int> &inliers);
+
+    private:
+        soaPoints3f X;
+        std::vector<float> u, v;
+        std::vector<unsigned char> mask;
+        std::vector<cv::Point3f> sample3d, refine3d;
+        std::vector<cv::Point2f> sample2d, refine2d;
+        cv::RNG rng;
+
+        int score(const rectifiedRig &cam, const float *R, const float *t, int best, unsigned char *m);
+};
+
+#endif
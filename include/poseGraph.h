@@ -61,7 +61,7 @@ class globalPoseGraph{
 
     void initializeGraph();
     void augmentNode(Eigen::Isometry3d localT, Eigen::Isometry3d globalT);
-    void addLoopClosure(Eigen::Isometry3d T, int fromID);
+    void addLoopClosure(Eigen::Isometry3d T, int fromID, int toID = -1);
     vector<Eigen::Isometry3d> globalOptimize();
     void saveStructure();
 };
@@ -110,10 +110,11 @@ void globalPoseGraph::augmentNode(Eigen::Isometry3d localT, Eigen::Isometry3d gl
     globalNodeID++;
 }
 
-void globalPoseGraph::addLoopClosure(Eigen::Isometry3d T, int fromID){
+// toID is the frame the loop was detected on, the latest vertex by default
+void globalPoseGraph::addLoopClosure(Eigen::Isometry3d T, int fromID, int toID){
     VertexSE3* cur = vertices[fromID];
     EdgeSE3* e = new EdgeSE3;
-    VertexSE3* prev = prevVertex;
+    VertexSE3* prev = (toID>=0 && toID<(int)vertices.size()) ? vertices[toID] : prevVertex;
     //Eigen::Isometry3d t = prev->estimate().inverse() * cur->estimate();
     Eigen::Isometry3d t = Eigen::Isometry3d::Identity();
     e->setVertex(0, prev);
@@ -138,6 +139,12 @@ vector<Eigen::Isometry3d> globalPoseGraph::globalOptimize(){
 }
 
 void globalPoseGraph::saveStructure(){
+    // one vertex per keyframe, a run that ended before its second keyframe
+    // has nothing to write
+    if(vertices.empty() || odometryEdges.empty()){
+        cerr<<"Pose graph has no edges, not writing "<<outFileName<<endl;
+        return;
+    }
     std::ofstream fileOutputStream;
     if (outFileName != "-") {
         cerr << "Writing into " << outFileName << endl;
@@ -0,0 +1,71 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef ROS_STEREO_SOURCE_H
+#define ROS_STEREO_SOURCE_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <condition_variable>
+
+#include "ros/ros.h"
+#include "ros/callback_queue.h"
+#include "sensor_msgs/Image.h"
+#include "sensor_msgs/CameraInfo.h"
+#include <message_filters/subscriber.h>
+#include <message_filters/synchronizer.h>
+#include <message_filters/sync_policies/approximate_time.h>
+
+#include "datasetSource.h"
+
+// Live rectified pair off two image topics. Pairs are matched on their
+// stamps and numbered in arrival order, load(i) waits for the i-th one. The
+// subscriptions spin on their own queue so a waiting load() never blocks the
+// node's ros::spinOnce(). Calibration comes from the camera_info topics when
+// given, the constructor waits a few seconds for them and then unsubscribes,
+// calib never changes after construction.
+class rosStereoSource : public datasetSource{
+    public:
+        rosStereoSource(const std::string &leftTopic, const std::string &rightTopic,
+                        const std::string &leftInfo = "", const std::string &rightInfo = "",
+                        size_t maxBuffered = 30);
+        ~rosStereoSource();
+
+        bool load(int idx, stereoFrame &frame);
+        int size() const { return -1; }
+        std::string describe() const { return "ROS topics " + left + " " + right; }
+        double timestamp(int idx) const;
+
+    private:
+        typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::Image> syncPolicy;
+
+        std::string left, right;
+        size_t maxBuffered;
+        ros::NodeHandle nh;
+        ros::CallbackQueue queue;
+        std::unique_ptr<ros::AsyncSpinner> spinner;
+        message_filters::Subscriber<sensor_msgs::Image> subL, subR;
+        std::unique_ptr<message_filters::Synchronizer<syncPolicy>> sync;
+        ros::Subscriber infoL, infoR;
+
+        mutable std::mutex m;
+        std::condition_variable arrived;
+        std::map<int, stereoFrame> frames;
+        std::map<int, double> stamps;
+        int received = 0;
+        double firstStamp = -1;
+        double PL[12], PR[12];
+        bool haveL = false, haveR = false;
+        // set when the constructor stops waiting, onInfo leaves calib alone
+        bool infoClosed = false;
+
+        void onPair(const sensor_msgs::ImageConstPtr &l, const sensor_msgs::ImageConstPtr &r);
+        void onInfo(const sensor_msgs::CameraInfoConstPtr &info, bool isLeft);
+};
+
+#endif
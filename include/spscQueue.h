@@ -0,0 +1,68 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+// bounded lock free ring for exactly one producer thread and one consumer
+// thread. capacity is rounded up to a power of two, head and tail live on
+// their own cache lines so the two sides don't fight over them.
+template<class T>
+class spscQueue{
+    public:
+        spscQueue(size_t capacity = 64){
+            size_t cap = 2;
+            while(cap<capacity){
+                cap <<= 1;
+            }
+            ring.resize(cap);
+            mask = cap - 1;
+        }
+
+        // producer side, false when full
+        bool tryPush(T &&item){
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if(t - head.load(std::memory_order_acquire) > mask){
+                return false;
+            }
+            ring[t & mask] = std::move(item);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, false when empty
+        bool tryPop(T &item){
+            const size_t h = head.load(std::memory_order_relaxed);
+            if(h==tail.load(std::memory_order_acquire)){
+                return false;
+            }
+            item = std::move(ring[h & mask]);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // approximate from any thread other than the two ends
+        size_t size() const{
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const{
+            return mask + 1;
+        }
+
+    private:
+        std::vector<T> ring;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif
@@ -22,6 +22,8 @@
 #include "pcl_ros/point_cloud.h"
 #include "pcl_conversions/pcl_conversions.h"
 #include <pcl/filters/statistical_outlier_removal.h>
+
+#include "datasetSource.h"
 //#include "pcl_ros/filters/statistical_outlier_removal.h"
 
 using namespace std;
@@ -34,7 +36,7 @@ class StereoProcess{
         ros::NodeHandle nh;
         ros::Publisher pub; 
     public:       
-        const char*lFptr; const char*rFptr;
+        std::shared_ptr<datasetSource> dataset;
         
         double baseline = 0.5707;
         double focal_x = 7.188560000000e+02;
@@ -47,17 +49,48 @@ class StereoProcess{
         bool init=false;
 
         cv::Mat lImg, rImg, prevImg;
+        cv::Mat grayIm1, grayIm2;
+        stereoFrame curFrame;
         vector<cv::Point3f> tri3dPoints, color3dMap;
 
-        StereoProcess(const char* lptr, const char* rptr){
-            lFptr = lptr;
-            rFptr = rptr;
+        // built once, reused on every frame
+        cv::Ptr<cv::StereoSGBM> sgbm;
+        cv::Ptr<cv::Feature2D> stereoSift, monoSift, brief;
+        cv::BFMatcher matcher;
+
+        StereoProcess(std::shared_ptr<datasetSource> source){
+            dataset = source;
+            const stereoCalibration &c = dataset->calib;
+            if(c.valid()){
+                focal_x = c.fx; focal_y = c.fy;
+                cx = c.cx; cy = c.cy;
+                baseline = c.baseline;
+                K = c.K();
+            }
+
+            int winSize = 1;
+            sgbm = cv::StereoSGBM::create(
+                1, 
+                96, 
+                7, 
+                8*3*winSize*winSize,
+                32*3*winSize*winSize,
+                0,
+                60,
+                0,
+                3000,
+                5
+            );
+            stereoSift = cv::xfeatures2d::SIFT::create(20000);
+            monoSift = cv::xfeatures2d::SIFT::create(10000);
+            brief = cv::xfeatures2d::BriefDescriptorExtractor::create();
+
             pub = nh.advertise<cloudType>("StereoCloud",1);
             ros::Rate loop_rate(10);
         }
 
         void pclPublish(vector<Point3f>&pts3d, vector<cv::Point3f>&colorMap);
-        cv::Mat getImg(const char* fptr, int iter);
+        cv::Mat getImg(int iter, bool right);
         void mainLoop();
         void stereoTriangulate(cv::Mat im1, cv::Mat im2, vector<cv::Point3f>&out3d);
         cv::Mat stereoMatch(int iter);
@@ -0,0 +1,50 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef STEREO_KERNELS_H
+#define STEREO_KERNELS_H
+
+#include <vector>
+#include <cstddef>
+
+// intrinsics + baseline of a rectified pair, right camera sits at +baseline on x
+struct rectifiedRig{
+    float fx, fy, cx, cy, baseline;
+};
+
+// structure of arrays point buffer, kept around so kernels don't reallocate
+struct soaPoints3f{
+    std::vector<float> x, y, z;
+
+    void resize(size_t n){
+        x.resize(n); y.resize(n); z.resize(n);
+    }
+    size_t size() const { return z.size(); }
+};
+
+// Closed form triangulation of rectified correspondences, depth straight from
+// disparity. ptsL/ptsR are interleaved (u,v) pairs, ie. the memory layout of
+// a vector<cv::Point2f>. Non positive disparities come out with z<=0 or inf,
+// callers are expected to drop those.
+void triangulateRectified(const rectifiedRig &rig, const float *ptsL, const float *ptsR,
+                          int n, float *X, float *Y, float *Z);
+
+void triangulateRectified(const rectifiedRig &rig, const float *ptsL, const float *ptsR,
+                          int n, soaPoints3f &out);
+
+// Reprojection test for PnP scoring : world points X/Y/Z go through the
+// world->camera pose (R row major, t) and the pinhole part of cam, and are
+// compared with the observations u/v. mask[i] (if given) is set to 1 where the
+// squared pixel error is below thr2 and the point is in front of the camera.
+// Returns how many passed.
+int reprojectionInliers(const rectifiedRig &cam, const float *R, const float *t,
+                        const float *X, const float *Y, const float *Z,
+                        const float *u, const float *v, int n, float thr2, unsigned char *mask);
+
+// name of the code path the kernels run, x86 picks it from the cpu at load time
+const char* stereoKernelISA();
+
+#endif
@@ -0,0 +1,65 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef STEREO_MATCHER_H
+#define STEREO_MATCHER_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "threadPool.h"
+
+struct stereoMatchParams{
+    float minDisparity = 0.5f;
+    float maxDisparity = 250.0f;
+    // max |left - (left->right->left)| in px
+    float lrThreshold = 1.0f;
+    int nStripes = 8;
+    cv::Size winSize = cv::Size(21,21);
+    int maxLevel = 3;
+    int maxIters = 30;
+    // stop once a disparity update is smaller than this many px
+    float epsilon = 0.01f;
+};
+
+// Left->right correspondence search for a rectified pair. Points are split
+// into horizontal stripes that are matched on a thread pool. The search is a
+// coarse to fine Lucas-Kanade in x only, the right point stays on the left
+// point's row, and every match has to survive a right->left consistency check
+// so no fundamental matrix RANSAC is needed afterwards.
+class stereoMatcher{
+    public:
+        stereoMatchParams params;
+
+        stereoMatcher(int nThreads, const stereoMatchParams &params);
+
+        // ptsL is filtered in place, ptsR gets the matching right image points.
+        // both pyramids must come from buildOpticalFlowPyramid with params.maxLevel,
+        // with or without derivatives
+        void match(const std::vector<cv::Mat> &pyrL, const std::vector<cv::Mat> &pyrR, int rows,
+                   std::vector<cv::Point2f> &ptsL, std::vector<cv::Point2f> &ptsR);
+
+    private:
+        struct stripeBuffer{
+            std::vector<cv::Point2f> left, right;
+            // template and its x gradient, one window
+            std::vector<float> patch, grad;
+        };
+
+        threadPool pool;
+        std::vector<stripeBuffer> stripes;
+
+        void matchStripe(const std::vector<cv::Mat> &pyrL, const std::vector<cv::Mat> &pyrR, stripeBuffer &s);
+        // x in to (full resolution) where the window around p in from lines
+        // up, starting at the guess in x. false when it leaves the image or
+        // the window has no x texture
+        bool searchRow(const std::vector<cv::Mat> &from, const std::vector<cv::Mat> &to,
+                       const cv::Point2f &p, float &x, stripeBuffer &s) const;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// small fixed size worker pool, tasks are run FIFO and hand back a future.
+class threadPool{
+    public:
+        threadPool(int nThreads){
+            if(nThreads<1){
+                nThreads = 1;
+            }
+            for(int i=0; i<nThreads; i++){
+                workers.emplace_back([this](){ workerLoop(); });
+            }
+        }
+
+        ~threadPool(){
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                stopFlag = true;
+            }
+            cond.notify_all();
+            for(std::thread &w : workers){
+                w.join();
+            }
+        }
+
+        template<class F>
+        std::future<typename std::result_of<F()>::type> enqueue(F&& f){
+            typedef typename std::result_of<F()>::type retType;
+            std::shared_ptr<std::packaged_task<retType()>> task(
+                new std::packaged_task<retType()>(std::forward<F>(f))
+            );
+            std::future<retType> res = task->get_future();
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                tasks.emplace([task](){ (*task)(); });
+            }
+            cond.notify_one();
+            return res;
+        }
+
+        int size() const{
+            return (int)workers.size();
+        }
+
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex queueMutex;
+        std::condition_variable cond;
+        bool stopFlag = false;
+
+        void workerLoop(){
+            while(true){
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    cond.wait(lock, [this](){ return stopFlag || !tasks.empty(); });
+                    if(stopFlag && tasks.empty()){
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        }
+};
+
+#endif
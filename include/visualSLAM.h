@@ -2,6 +2,7 @@
 #include <vector>
 #include <algorithm>
 #include <thread>
+#include <deque>
 #include <stdio.h>
 
 #include <opencv2/core.hpp>
@@ -32,6 +33,21 @@
 #include "DloopDet.h"
 #include "TemplatedLoopDetector.h"
 #include "monoUtils.h"
+#include "framePrefetcher.h"
+#include "frameCache.h"
+#include "datasetSource.h"
+#include "stereoKernels.h"
+#include "stereoMatcher.h"
+#include "featureExtraction.h"
+#include "pipelineStage.h"
+#include "motionModel.h"
+#include "pnpRansac.h"
+#include "compaction.h"
+#include "landmarkTable.h"
+#include "gridIndex.h"
+#include "keyFramePolicy.h"
+#include "keyFrameStore.h"
+#include "binaryVocabulary.h"
 
 using namespace std;
 using namespace cv;
@@ -44,13 +60,49 @@ using namespace DBoW2;
 typedef pcl::PointCloud<pcl::PointXYZRGB> cloudType;
 typedef TemplatedDatabase<DBoW2::FORB::TDescriptor, DBoW2::FORB> KeyFrameSelection;
 
-struct keyFrame{
+// one per frame, pose only
+struct framePose{
     int idx = -1;
-    bool retrack = false;
+    // keyFrameHistory entry the frame tracked against
+    int keyFrame = -1;
     Mat R,t;
-    vector<Point3f> ref3dCoords;
-    vector<Point3f> transformed3d;
-    vector<Point2f> refFeats;
+};
+
+// what the tracker hands to the worker stages, everything is owned by the job
+// so the tracker can move on as soon as it is queued
+struct loopJob{
+    int idx = -1;
+    Mat gray;
+};
+
+struct loopCandidate{
+    int query = -1;
+    int match = -1;
+};
+
+struct mapJob{
+    int idx = -1;
+    bool keyframe = false;
+    // world corrections the tracker had applied when it made this job
+    int epoch = 0;
+    // set on the keyframe that closes a loop, matched and detection frames
+    int loopMatch = -1, loopQuery = -1;
+    Mat R, t, pose4dTransform;
+    // keyframe cloud in the camera frame and its colours, empty otherwise
+    vector<Point3f> cloud;
+    vector<uint32_t> rgb;
+    // pose records in frame order, this job's frame last. earlier ones are
+    // frames whose own job found the queue full
+    vector<framePose> poses;
+};
+
+struct publishJob{
+    int idx = -1;
+    Mat gray, color;
+    Mat R, t, invTransform;
+    // tracked points and where they came from in the previous frame
+    vector<Point3f> pts3d;
+    vector<Point2f> pts2d, prevPts2d;
 };
 
 class visualSLAM{
@@ -61,23 +113,51 @@ class visualSLAM{
         ros::Publisher posePublisher;
         ros::Publisher trajectoryPublisher;
 
+        // publish thread only : the path gets a pose every pathEvery frames
+        // and keeps the last poseWindow of them, the cloud goes out when
+        // renderVersion moved
         nav_msgs::Path trajectoryMsg;
+        int pathEvery = 10, lastPathFrame = -100000;
+        long publishedVersion = -1;
 
     public:
         int seqNo;
         double baseline = 0.54;
         int Xbias = 750;
         int Ybias = 200;
-        int LCidx = 0;
-        int cooldownTimer = 0;
+        // last loop closure, matched frame and the frame it was detected on
+        int LCidx = 0, LCquery = -1;
         bool LC_FLAG = false;
         bool SHUTDOWN_FLAG = false;
         bool RENDER_SHUTDOWN = false;
         bool DENSE_FLAG = true;
-        double trackFPS = 0.0;
-
-        string absPath;
-        const char* lFptr; const char* rFptr;
+        bool GRAY_FLAG = true;
+        bool RECTIFIED_FLAG = true;
+        bool BUCKET_FLAG = false;
+        bucketParams bucketConfig;
+        Size lkWinSize = Size(21,21);
+        int lkMaxLevel = 3;
+        std::atomic<double> trackFPS{0.0};
+        bool PUBLISH_FLAG = true;
+        int prefetchDepth = 8;
+        int decodeThreads = 2;
+        int stereoThreads = 4;
+        // frame to frame LK outlier rejection : round trip check, and the old
+        // fundamental matrix RANSAC which PnP RANSAC makes mostly redundant
+        bool FB_CHECK_FLAG = true;
+        float fbThreshold = 1.0f;
+        bool FMAT_FLAG = false;
+        // motion model prior for LK and PnP, RANSAC only when it doesn't hold up
+        bool MOTION_FLAG = true;
+        double guidedGate = 6.0;
+        double guidedMinInlierRatio = 0.5;
+        int guidedMinInliers = 80;
+        int guidedFrames = 0, ransacFrames = 0;
+        // in-tree PnP RANSAC instead of solvePnPRansac
+        bool CUSTOM_PNP_FLAG = true;
+        long pnpHypotheses = 0, pnpPreRejected = 0;
+
+        std::shared_ptr<datasetSource> dataset;
 
         double focal_x = 7.188560000000e+02;
         double cx = 6.071928000000e+02;
@@ -87,34 +167,133 @@ class visualSLAM{
         Mat K = (Mat1d(3,3) << focal_x, 0, cx, 0, focal_y, cy, 0, 0, 1);
         
         Mat referenceImg, currentImage;
-        vector<Point3f> referencePoints3D, mapPts, untransformed, colors;
-        vector<Point2f> referencePoints2D, refDrawPts, trackedDrawPts;
-        vector<vector<Point3f>> mapHistory, colorHistory;
+        vector<Mat> referencePyr, currentPyr;
+        vector<Point3f> mapPts;
+        vector<Point2f> refDrawPts, trackedDrawPts;
+        // points the tracker currently follows, world frame
+        landmarkTable landmarks;
+        // colours of the points the last keyframe added
+        vector<uint32_t> mapRgb;
+        // keyframes keep the tracks that survived and only add points in the
+        // gaps, trackRadius px away from any of them
+        bool PERSIST_FLAG = true;
+        int trackRadius = 10;
+        gridIndex trackIndex;
+        vector<uchar> keptMask;
+
+        // when to take a keyframe, and the tracker side state it looks at
+        std::shared_ptr<keyFramePolicy> kfPolicy;
+        int lastKfFrame = 0, lastKfTracks = 0, lastKfMaxId = -1;
+        Mat lastKfR, lastKfT;
+        // latest tracked frame, for the ground truth check in the stats
+        int lastIter = 0;
+        Mat lastT;
+        long kfCount[KF_REASONS] = {};
+        vector<float> parallaxBuf;
+        vector<vector<Point3f>> mapHistory;
+        vector<vector<uint32_t>> colorHistory;
         vector<cv::Mat> trajectory;
         vector<cv::Mat> Rhistory;
-        vector<keyFrame> keyFrameHistory;
-        vector<vector<double>> gtTraj;
+        keyFrameStore keyFrameHistory;
+        vector<framePose> poseHistory;
+        // what stays in RAM on long runs : the viewer gets the clouds of the
+        // last renderWindow keyframes (mapHistory[0] is keyframe mapFirstKf),
+        // pose lists keep the last poseWindow entries. expectedFrames only
+        // sizes initial allocations
+        size_t renderWindow = 300, poseWindow = 5000;
+        size_t mapFirstKf = 0;
+        int expectedFrames = 4500;
         vector<Eigen::Isometry3d> isoVector;
 
         vector<Point2f> inlierReferencePyrLKPts;
+        // tracking scratch, sized by the first frames and reused after that
+        vector<Point2f> lkTrackPts, lkBackPts;
+        vector<uchar> lkStatus, lkBackStatus, lkSeeded, fmMask, triMask;
+        vector<float> lkErr;
+        vector<Point2f> pnpProj, pnpGated2d;
+        vector<Point3f> pnpGated3d;
+        vector<uchar> pnpGate;
+        soaPoints3f triBuffer;
         Mat canvas = Mat::zeros(X_BOUND, Y_BOUND, CV_8UC3);
         Mat ret, drw;
 
+        // mapping thread only : one vertex per keyframe, vertexFrames[v] is
+        // the frame of vertex v
         globalPoseGraph poseGraph;
-
-        std::shared_ptr<OrbLoopDetector> loopDetector;
+        vector<int> vertexFrames;
+        // a loop closure moves the world. the mapping thread posts the move
+        // (x_new = T*x_old) and the tracker applies it to what it holds, jobs
+        // made before that are brought along on the mapping side. only the
+        // corrections a job may still be behind on are kept
+        spscQueue<Eigen::Isometry3d> worldCorrections{16};
+        int correctionsApplied = 0;
+        std::deque<Eigen::Isometry3d> postedCorrections;
+        int correctionBase = 0;
+        // composed corrections that found the queue full
+        Eigen::Isometry3d unpostedCorrection = Eigen::Isometry3d::Identity();
+        bool correctionPending = false;
+
+        // the detector quantizes through voc, so voc goes first and is
+        // destroyed last
         std::shared_ptr<OrbVocabulary> voc;
+        std::shared_ptr<OrbLoopDetector> loopDetector;
         std::shared_ptr<KeyFrameSelection> KFselector;
+        std::shared_ptr<framePrefetcher> prefetcher;
+        std::shared_ptr<stereoMatcher> stereoEngine;
+        std::shared_ptr<featureExtractor> featureService;
+        stereoFrame curFrame;
+        bool curFrameOk = false;
+        motionModel motion;
+        pnpRansac pnpEngine;
+
+        // tracking runs on the calling thread, everything else hangs off these
+        std::shared_ptr<pipelineStage<loopJob>> loopStage;
+        std::shared_ptr<pipelineStage<mapJob>> mappingStage;
+        std::shared_ptr<pipelineStage<publishJob>> publishStage;
+        spscQueue<loopCandidate> loopResults{8};
+        // loop worker only : frame of every database entry, and closures at
+        // least loopCooldown frames apart. at loopDbCapacity entries the
+        // detector drops its most redundant quarter, loopEntryFrames follows
+        vector<int> loopEntryFrames;
+        int loopDbCapacity = 2000, loopThinnings = 0;
+        int loopCooldown = 100, lastLoopFrame = -100000;
+        // closures must span at least loopMinGap frames, in frames since the
+        // database only holds keyframes
+        int loopMinGap = 100;
+        // accepted closures whose frames are within loopGtRadius metres of
+        // each other in the ground truth, and those that aren't
+        double loopGtRadius = 10.0;
+        std::atomic<long> loopGtTrue{0}, loopGtFalse{0};
+        // database feed : keyframes only, and/or frames whose BoW score
+        // against the last entry stays under loopGateScore (0 turns the gate
+        // off). entries map back to frames through loopEntryFrames
+        bool LOOP_KF_FLAG = true;
+        double loopGateScore = 0;
+        BowVector lastLoopBow;
+        std::atomic<long> loopGated{0}, loopDbSize{0};
+        // frames the tracker may run ahead of loop detection before frames
+        // are skipped, and how far behind the accepted closures were
+        size_t loopQueueDepth = 16;
+        long loopsClosed = 0, loopLagFrames = 0;
+        // last filtered keyframe cloud, only touched by the mapping thread
+        vector<Point3f> keyFrameCloud;
+        // tracker only : pose records still waiting for room in the mapping
+        // queue
+        vector<framePose> poseBacklog;
 
         mutex renderMutex;
+        // bumped under renderMutex whenever isoVector/mapHistory/colorHistory
+        // change, the viewer only copies them when it moved
+        long renderVersion = 0;
+        mutex viewMutex;
+        Mat debugView, frameView;
         
         std::string vocfile;
         std::string plySavepath = "map.ply";
         string trajectory_file = "trajectory.txt";
 
-        visualSLAM(int Seq, const char*Lfptr, const char*Rfptr, std::string vocPath){
-            lFptr = Lfptr;
-            rFptr = Rfptr;
+        visualSLAM(std::shared_ptr<datasetSource> source, std::string vocPath){
+            setDataset(source);
             vocfile = vocPath;
 
             Params param;
@@ -122,19 +301,52 @@ class visualSLAM{
             param.image_cols = 376;
             param.use_nss = true;
             param.alpha = 0.9;
-            param.k = 1;
             param.geom_check = GEOM_DI;
             param.di_levels = 2;
+            param.max_entries = loopDbCapacity;
+            // the database holds keyframes, a few frames to tens of frames
+            // apart, so both count keyframes. dislocal only has to keep the
+            // last few entries out of the query, loopMinGap does the real
+            // separation in frames. one consistent keyframe spans what two
+            // consistent frames did before, the DI geometric check stays
+            param.dislocal = 5;
+            param.k = 0;
 
 
 
-            voc.reset(new OrbVocabulary());
             cerr<<"Loading Place Recognition vocabulary : "<<vocfile<<endl;
-            voc->load(vocfile);
+            voc = loadOrbVocabulary(vocfile);
+            if(!voc){
+                // an empty vocabulary quantizes nothing, so no loop is ever found
+                cerr<<"No vocabulary, loop closure is disabled"<<endl;
+                voc.reset(new OrbVocabulary());
+            }
             cerr<<"Done"<<endl;
 
             loopDetector.reset(new OrbLoopDetector(*voc, param));
-            loopDetector->allocate(4000);
+            loopDetector->allocate(std::min(expectedFrames, loopDbCapacity));
+
+            prefetcher.reset(new framePrefetcher(
+                [this](int i, stereoFrame&f){ return decodeStereoPair(i, f); },
+                prefetchDepth, decodeThreads
+            ));
+
+            stereoMatchParams stereoParams;
+            stereoParams.winSize = lkWinSize;
+            stereoParams.maxLevel = lkMaxLevel;
+            stereoEngine.reset(new stereoMatcher(stereoThreads, stereoParams));
+            featureService.reset(new featureExtractor(1000));
+            kfPolicy.reset(new multiCueKeyFramePolicy());
+
+            loopStage.reset(new pipelineStage<loopJob>(
+                [this](loopJob&j){ checkLoopDetectorStatus(j.gray, j.idx); }, loopQueueDepth
+            ));
+            mappingStage.reset(new pipelineStage<mapJob>(
+                [this](mapJob&j){ mapFrame(j); }, 64
+            ));
+            publishStage.reset(new pipelineStage<publishJob>(
+                [this](publishJob&j){ publishFrame(j); }, 4, true
+            ));
 
             mapPublisher = nh.advertise<cloudType>("SLAM/map",1);
             posePublisher = nh.advertise<geometry_msgs::PoseStamped>("SLAM/pose",1);
@@ -150,33 +362,56 @@ class visualSLAM{
         }
 
         vector<KeyPoint> denseKeypointExtractor(Mat img, int stepSize);
-        void denseLKtracking(Mat refImg, Mat curImg, vector<Point2f>&refPts, vector<Point2f>&trackPts);
+        void denseLKtracking(const vector<Mat>&refPyr, const vector<Mat>&curPyr, vector<Point2f>&refPts, vector<Point2f>&trackPts);
         void FmatThresholding(vector<Point2f>&refPts, vector<Point2f>&trkPts);
 
         void checkLoopDetectorStatus(Mat img, int idx);
-        void stereoTriangulate(Mat im1, Mat im2, 
-                            vector<Point3f>&ref3dPts, 
-                            vector<Point2f>&ref2dPts);
-        void PyrLKtrackFrame2Frame(Mat refimg, Mat curImg, vector<Point2f>refPts, vector<Point3f>ref3dpts,
-                                            vector<Point2f>&refRetpts, vector<Point3f>&ref3dretPts);
+        void stereoTriangulate(stereoFrame&frame, landmarkTable&lm, bool keepTracks = false);
+        bool nearTrack(const Point2f&p) const;
+        void PyrLKtrackFrame2Frame(const vector<Mat>&refPyr, const vector<Mat>&curPyr, landmarkTable&lm,
+                                            const Mat&rvecPred = Mat(), const Mat&tvecPred = Mat());
         vector<int> removeDuplicates(vector<Point2f>&baseref2dFeatures, vector<Point2f>&newref2dFeatures,
                                     vector<int>&mask, int radius=10);
-        void insertKeyFrames(int start, Mat imL, Mat imR, Mat&pose4dTransform, vector<Point2f>&ftrPts, vector<Point3f>&ref3dCoords);
+        void insertKeyFrames(int start, stereoFrame&frame, Mat&pose4dTransform, landmarkTable&lm, vector<Point3f>&camPts,
+                             bool keepTracks = false);
         vector<Point3f> update3dtransformation(vector<Point3f>& pt3d, Mat& pose4dTransform);
+        keyFrameSignals gatherKeyFrameSignals(int iter, const Mat&R, const Mat&t, const vector<int>&inliers);
+        void markKeyFrame(int iter, const Mat&R, const Mat&t);
+        void setDataset(std::shared_ptr<datasetSource> source);
+        bool decodeStereoPair(int iter, stereoFrame&frame);
+        void prepareRight(stereoFrame&frame);
+        bool completeStereoPair(stereoFrame&frame);
+        stereoFrame& fetchFrame(int iter);
         Mat loadImageL(int iter);
         Mat loadImageR(int iter);
-        void PerspectiveNpointEstimation(Mat&prevImg, Mat&curImg, vector<Point2f>&ref2dPoints, vector<Point3f>&ref3dPoints, 
-                                        vector<Point2f>&tracked2dPoints, vector<Point3f>&tracked3dPoints, Mat&rvec, Mat&tvec,vector<int>&inliers);
+        void PerspectiveNpointEstimation(landmarkTable&lm, Mat&rvec, Mat&tvec, vector<int>&inliers);
+        void ransacPnP(const vector<Point3f>&pts3d, const vector<Point2f>&pts2d, Mat&rvec, Mat&tvec, vector<int>&inliers,
+                       float threshold, double confidence);
+        bool guidedPnP(const vector<Point3f>&pts3d, const vector<Point2f>&pts2d, Mat&rvec, Mat&tvec, vector<int>&inliers);
         void initSequence();
+        void startPipeline();
+        void stopPipeline();
+        void printPipelineStats();
+        void mapFrame(mapJob&job);
+        void recordPose(framePose&fp);
+        void publishFrame(publishJob&job);
 
         void initPangolin();
-        void DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<Point3f>>&pts3,vector<vector<Point3f>>&colorData);
+        void DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<Point3f>>&pts3,vector<vector<uint32_t>>&colorData);
 
         Mat drawDepthCMap(Mat image, vector<Point3f>&pts3d, vector<Point2f>&ref2d, vector<Point2f>&trk2d);
 
-        void stageForPGO(Mat Rl, Mat tl, Mat Rg, Mat tg, bool loopClose);
+        int stageForPGO(int frame, const Mat&R, const Mat&t, int loopMatch = -1, int loopQuery = -1);
+        int vertexOf(int frame) const;
+        void closeLoop(int vertex);
+        void postCorrection(const Eigen::Isometry3d&C);
+        void correctJob(mapJob&job);
+        void applyWorldCorrection(const Eigen::Isometry3d&C);
         void updateOdometry(vector<Eigen::Isometry3d>&T);
 
-        void SORcloud(vector<Point3f>&ref3d, vector<Point3f>&colorMap);
+        void SORcloud(vector<Point3f>&ref3d, vector<uint32_t>&colorMap);
         void rosPublish(vector<vector<Point3f>>&pt3d, Mat&trajROS, Mat&Rmat);
+        void publishCloud(const vector<vector<Point3f>>&pt3d, const vector<vector<uint32_t>>&colors);
+        void publishPose(const Mat&trajROS, const Mat&Rmat, bool toPath);
+        void exportMap();
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#ifndef VOCABULARY_TRAINER_H
+#define VOCABULARY_TRAINER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+#include "binaryVocabulary.h"
+#include "threadPool.h"
+
+// Training descriptors on disk:
+//   [header][packed 256 bit descriptors ...][image offsets]
+// descriptors start on a 64 byte boundary, image i owns
+// [offset[i], offset[i+1]). the index sits at the end so extraction can
+// stream images in.
+#define ORB_FEATURE_MAGIC "RSORBFTS"
+#define ORB_FEATURE_VERSION 1
+
+struct orbFeatureHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t nImages;
+    uint64_t nDescriptors;
+    uint64_t indexOffset;
+};
+
+class orbFeatureWriter{
+    public:
+        ~orbFeatureWriter();
+
+        bool open(const std::string &path);
+        // one image worth of CV_8U, 32 column ORB descriptors (may be empty)
+        bool append(const cv::Mat &descriptors);
+        bool close();
+
+    private:
+        FILE *fp = NULL;
+        orbFeatureHeader header = orbFeatureHeader();
+        std::vector<uint64_t> offsets;
+};
+
+// Read only mapping of a feature file, the descriptors are paged in by the
+// kernel as training touches them instead of sitting in cv::Mat rows.
+class orbFeatureFile{
+    public:
+        ~orbFeatureFile();
+
+        bool open(const std::string &path);
+        void close();
+
+        int images() const { return (int)header.nImages; }
+        size_t size() const { return header.nDescriptors; }
+        const packedDescriptor* descriptors() const { return desc; }
+        size_t imageBegin(int i) const { return offsets[i]; }
+        size_t imageEnd(int i) const { return offsets[i+1]; }
+
+    private:
+        unsigned char *base = NULL;
+        size_t mappedBytes = 0;
+        orbFeatureHeader header = orbFeatureHeader();
+        const packedDescriptor *desc = NULL;
+        const uint64_t *offsets = NULL;
+};
+
+// ORB on every image, decoded and extracted on the pool and written in image
+// order. only a few images per thread are in flight at any time
+bool extractOrbFeatures(const std::vector<std::string> &images, const std::string &featureFile,
+                        int nFeatures, threadPool &pool);
+
+// Hierarchical k-medians with k-means++ seeding, the DBoW2 create() recipe,
+// built one tree level at a time. every node of a level is clustered as its
+// own pool task, nodes with many descriptors (the first levels) split their
+// seeding, assignment and median passes across the pool instead. Leaves
+// become words, weights come from the training images as in DBoW2. The
+// result saves as DBoW2 YAML (save()) or the binary format (saveBinary()).
+class vocabularyTrainer : public binaryOrbVocabulary{
+    public:
+        vocabularyTrainer(int k, int L, DBoW2::WeightingType weighting, DBoW2::ScoringType scoring);
+
+        bool train(const orbFeatureFile &features, threadPool &pool);
+
+        // DBoW2 iterates until assignments stop changing, majority medians
+        // can flip back and forth on large nodes so this caps it
+        int maxIterations = 100;
+        // nodes at least this big use the whole pool for their own passes
+        size_t parallelNodeSize = 16384;
+
+    private:
+        cv::Mat nodeDescriptors;
+
+        void setWeights(const orbFeatureFile &features, threadPool &pool);
+};
+
+#endif
@@ -1,82 +1,99 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include <thread>
+#include <chrono>
 #include <stdio.h>
 
 #include <opencv2/core.hpp>
 #include <opencv2/features2d.hpp>
-#include <opencv2/xfeatures2d.hpp>
-#include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include "opencv2/highgui/highgui.hpp"
-#include <opencv2/opencv.hpp>
+
+#include "../include/ANMS.h"
 
 using namespace cv;
 using namespace std;
 
-void adaptiveNonMaximalSuppresion( std::vector<cv::KeyPoint>& keypoints,
-                                    const int numToKeep )
-{
-    if( keypoints.size() < numToKeep ) { return; }
+// the quadratic version takes minutes past this, not worth waiting for
+static const int legacyLimit = 20000;
 
-    //
-    // Sort by response
-    //
-    std::sort( keypoints.begin(), keypoints.end(),
-                [&]( const cv::KeyPoint& lhs, const cv::KeyPoint& rhs )
-                {
-                return lhs.response > rhs.response;
-                } );
+static Mat syntheticFrame(){
+    Mat im(376, 1241, CV_8UC1);
+    RNG rng(7);
+    rng.fill(im, RNG::UNIFORM, 0, 255);
+    GaussianBlur(im, im, Size(3,3), 0.8);
+    return im;
+}
 
-    std::vector<cv::KeyPoint> anmsPts;
+static double timeIt(void (*fn)(vector<KeyPoint>&, int, int, int), vector<KeyPoint> kps,
+                     int numToKeep, int cols, int rows, size_t &kept){
+    auto t0 = chrono::high_resolution_clock::now();
+    fn(kps, numToKeep, cols, rows);
+    auto t1 = chrono::high_resolution_clock::now();
+    kept = kps.size();
+    return chrono::duration<double, std::milli>(t1-t0).count();
+}
 
-    std::vector<double> radii;
-    radii.resize( keypoints.size() );
-    std::vector<double> radiiSorted;
-    radiiSorted.resize( keypoints.size() );
+static void runLegacy(vector<KeyPoint> &kps, int numToKeep, int, int){
+    adaptiveNonMaximalSuppresion(kps, numToKeep);
+}
 
-    const float robustCoeff = 1.11; // see paper
+static void runSSC(vector<KeyPoint> &kps, int numToKeep, int cols, int rows){
+    sscNonMaximalSuppression(kps, numToKeep, cols, rows);
+}
 
-    for( int i = 0; i < keypoints.size(); ++i )
-    {
-    const float response = keypoints[i].response * robustCoeff;
-    double radius = std::numeric_limits<double>::max();
-    for( int j = 0; j < i && keypoints[j].response > response; ++j )
-    {
-        radius = std::min( radius, cv::norm( keypoints[i].pt - keypoints[j].pt ) );
+int main(int argc, char **argv){
+    Mat image;
+    if(argc>1){
+        image = imread(argv[1], IMREAD_GRAYSCALE);
     }
-    radii[i]       = radius;
-    radiiSorted[i] = radius;
+    if(!image.data){
+        cerr<<"usage : "<<argv[0]<<" [image.png [show]], using a synthetic frame"<<endl;
+        image = syntheticFrame();
     }
-
-    std::sort( radiiSorted.begin(), radiiSorted.end(),
-                [&]( const double& lhs, const double& rhs )
-                {
-                return lhs > rhs;
-                } );
-
-    const double decisionRadius = radiiSorted[numToKeep];
-    for( int i = 0; i < radii.size(); ++i ){
-        if( radii[i] >= decisionRadius ){
-            anmsPts.push_back( keypoints[i] );
+    const int numToKeep = 1000;
+
+    // threshold 1 gives far more corners than any count below
+    vector<KeyPoint> all;
+    cv::FAST(image, all, 1);
+    cout<<all.size()<<" FAST corners, keeping "<<numToKeep<<endl;
+
+    // subsample so every count sees the same spread of responses
+    RNG rng(0);
+    cv::randShuffle(all, 1.0, &rng);
+
+    const int counts[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000};
+    printf("%8s %12s %8s %12s %8s\n", "points", "legacy ms", "kept", "ssc ms", "kept");
+    for(int n : counts){
+        if(n>(int)all.size()){
+            break;
+        }
+        vector<KeyPoint> kps(all.begin(), all.begin()+n);
+        size_t keptLegacy = 0, keptSSC = 0;
+        double tSSC = timeIt(runSSC, kps, numToKeep, image.cols, image.rows, keptSSC);
+        if(n<=legacyLimit){
+            double tLegacy = timeIt(runLegacy, kps, numToKeep, image.cols, image.rows, keptLegacy);
+            printf("%8d %12.2f %8zu %12.2f %8zu\n", n, tLegacy, keptLegacy, tSSC, keptSSC);
+        }
+        else{
+            printf("%8d %12s %8s %12.2f %8zu\n", n, "-", "-", tSSC, keptSSC);
         }
     }
 
-    anmsPts.swap( keypoints );
+    if(argc>2){
+        vector<KeyPoint> kps = all;
+        sscNonMaximalSuppression(kps, numToKeep, image.cols, image.rows);
+        Mat vis;
+        cvtColor(image, vis, COLOR_GRAY2BGR);
+        drawKeypoints(vis, kps, vis, Scalar(0,255,0));
+        imshow("SSC kps : ", vis);
+        waitKey(0);
+    }
+    return 0;
 }
-
-int main(){
-    cv::Mat image = imread("/media/gautham/Seagate Backup Plus Drive/Datasets/ColorSeq/dataset/sequences/00/image_3/000000.png");
-    imshow("Original : ", image);
-
-    vector<KeyPoint> anmsKps;
-    vector<KeyPoint> orbKps;
-
-    cv::FAST(image, anmsKps, 1);
-
-    drawKeypoints(image, anmsKps, image, Scalar(0,255,0));
-    imshow("Default kps : ", image);
-
-    int k = waitKey(0);
-}
\ No newline at end of file
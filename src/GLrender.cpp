@@ -31,7 +31,7 @@ void loopSequence(string master){
   ack =  master.substr(seed, CHAR_LIM);
 }
 
-void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<Point3f>>&pts3,vector<vector<Point3f>>&colorData){
+void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&sharedPoses, vector<vector<Point3f>>&sharedPts3,vector<vector<uint32_t>>&sharedColors){
   pangolin::CreateWindowAndBind("Trajectory Viewer", 1024, 768);
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_POINT_SMOOTH);
@@ -60,9 +60,18 @@ void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<P
   pangolin::Var<double> menuVarThr("menu.Variance Th", 1, 1, 300, false);
   pangolin::Var<bool> menuResetButton("menu.Reset", false, false);
   pangolin::Var<double> menuTrackFps("menu.Tracking FPS", 0, 0, 0, false);
+  pangolin::Var<double> menuMapRate("menu.Mapping jobs/s", 0, 0, 0, false);
+  pangolin::Var<int> menuLoopQueue("menu.Loop queue", 0, 0, 0, false);
+  pangolin::Var<int> menuMapQueue("menu.Map queue", 0, 0, 0, false);
   //pangolin::Var<string> menuString("menu.@","", false);
 
   int renderIter = 0;
+  // what this thread draws, refreshed from the shared buffers when the map
+  // changed since the last copy
+  vector<Eigen::Isometry3d> poses;
+  vector<vector<Point3f>> pts3;
+  vector<vector<uint32_t>> colorData;
+  long drawnVersion = -1;
 
   while (pangolin::ShouldQuit() == false) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -73,7 +82,26 @@ void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<P
     
     pangolin::OpenGlMatrix Twc;
 
+    // only the copy happens under the lock, the mapping stage never waits
+    // for a draw to finish
     renderMutex.lock();
+    if(renderVersion!=drawnVersion){
+      poses = sharedPoses;
+      pts3 = sharedPts3;
+      colorData = sharedColors;
+      drawnVersion = renderVersion;
+    }
+    menuTrackFps = trackFPS;
+    menuMapRate = mappingStage->stats.throughput();
+    menuLoopQueue = (int)loopStage->depth();
+    menuMapQueue = (int)mappingStage->depth();
+    renderMutex.unlock();
+    if(poses.empty()){
+      pangolin::FinishFrame();
+      usleep(5000);
+      continue;
+    }
+
     Eigen::Isometry3d TwcEigen = poses[poses.size()-1];
     Eigen::Matrix<double,4,4> currentPose = TwcEigen.matrix();
 
@@ -238,8 +266,8 @@ void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<P
     } 
 
     for(size_t j=0; j<pts3.size(); j++){
-        vector<Point3f> localPts = pts3[j];
-        vector<Point3f> localColors = colorData[j];
+        const vector<Point3f> &localPts = pts3[j];
+        const vector<uint32_t> &localColors = colorData[j];
 
         if(!menuUseRGB && j==pts3.size()-1){
           glPointSize(menuPtSize);
@@ -267,11 +295,11 @@ void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<P
         }
         glBegin(GL_POINTS);
         for(size_t k=0; k<localPts.size(); k++){
-            Point3f p = localPts[k];
-            Point3f c = localColors[k];
-            double x = p.x; double r = c.z;
-            double y = p.y; double g = c.y;
-            double z = p.z; double b = c.x;
+            const Point3f &p = localPts[k];
+            const uint32_t c = localColors[k];
+            double x = p.x; double r = redOf(c);
+            double y = p.y; double g = greenOf(c);
+            double z = p.z; double b = blueOf(c);
             if(menuUseRGB){
                 glColor3f(r/255 ,g/255, b/255);
             }
@@ -288,8 +316,6 @@ void visualSLAM::DrawTrajectory(vector<Eigen::Isometry3d>&poses, vector<vector<P
         glEnd();
     }
 
-    menuTrackFps = trackFPS;
-    renderMutex.unlock();
 
     // loopSequence("      GauthamJ.S ; AkashSharma ; SuryankKumar");
     // if(interval==0){
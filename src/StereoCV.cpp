@@ -7,20 +7,25 @@
 using namespace std; using namespace cv;
 
 
-Mat StereoProcess::getImg(const char* fptr, int iter){
-    char filename[200];
-    sprintf(filename,fptr,iter);
-
-    Mat im = imread(filename);
-    if(!im.data){
-        cout<<"\n\nYIKES Dawg, Failed to fetch frame, check the file path\n\n"<<endl;
+Mat StereoProcess::getImg(int iter, bool right){
+    if(curFrame.idx!=iter){
+        curFrame = stereoFrame();
+        if(!dataset->load(iter, curFrame)){
+            cout<<"\n\nYIKES Dawg, Failed to fetch frame "<<iter<<" of "<<dataset->describe()<<"\n\n"<<endl;
+            curFrame.idx = -1;
+            return Mat();
+        }
+        curFrame.idx = iter;
     }
-    return im;
+    return right ? curFrame.imR : curFrame.imL;
 }
 
 Mat StereoProcess::stereoMatch(int iter){
-    Mat im1 = getImg(lFptr, iter);
-    Mat im2 = getImg(rFptr, iter);
+    Mat im1 = getImg(iter, false);
+    Mat im2 = getImg(iter, true);
+    if(im1.empty() || im2.empty()){
+        return Mat();
+    }
 
     double lambda = 400; double sigma = 0.4;
 
@@ -30,28 +35,14 @@ Mat StereoProcess::stereoMatch(int iter){
     //cvtColor(im2, im2, CV_BGR2RGB);
 
     lImg = im1; rImg = im2;
-    Mat grayIm1, grayIm2;
 
     cvtColor(im1, grayIm1, CV_BGR2GRAY);
     cvtColor(im2, grayIm2, CV_BGR2GRAY);
 
-    int winSize = 1;
-    Ptr<StereoSGBM> matcher = StereoSGBM::create(
-        1, 
-        96, 
-        7, 
-        8*3*winSize*winSize,
-        32*3*winSize*winSize,
-        0,
-        60,
-        0,
-        3000,
-        5
-    );
-    //wls_filter = ximgproc::createDisparityWLSFilter(matcher);
-    //Ptr<StereoMatcher> right_matcher = ximgproc::createRightMatcher(matcher);
+    //wls_filter = ximgproc::createDisparityWLSFilter(sgbm);
+    //Ptr<StereoMatcher> right_matcher = ximgproc::createRightMatcher(sgbm);
     Mat disp, rdisp, filtDisp;
-    matcher->compute(grayIm1, grayIm2, disp);
+    sgbm->compute(grayIm1, grayIm2, disp);
     //right_matcher->compute(grayIm2, grayIm1,rdisp);
     //wls_filter->setLambda(lambda);
     //ls_filter->setSigmaColor(sigma);
@@ -62,11 +53,9 @@ Mat StereoProcess::stereoMatch(int iter){
 }
 
 void StereoProcess::stereoTriangulate(cv::Mat im1, cv::Mat im2, vector<cv::Point3f>&out3d){
-    Ptr<FeatureDetector> detector = xfeatures2d::SIFT::create(20000);
-    Ptr<FeatureDetector> brief = xfeatures2d::BriefDescriptorExtractor::create();
     vector<KeyPoint> kp1, kp2;
-    detector->detect(im1, kp1);
-    detector->detect(im2, kp2);
+    stereoSift->detect(im1, kp1);
+    stereoSift->detect(im2, kp2);
 
     Mat desc1, desc2;
     brief->compute(im1, kp1, desc1);
@@ -74,7 +63,6 @@ void StereoProcess::stereoTriangulate(cv::Mat im1, cv::Mat im2, vector<cv::Point
     desc1.convertTo(desc1, CV_32F);
     desc2.convertTo(desc2, CV_32F);
 
-    BFMatcher matcher;
     vector<vector<DMatch>> matches;
 
     matcher.knnMatch(desc1, desc2, matches,2);
@@ -121,19 +109,16 @@ void StereoProcess::stereoTriangulate(cv::Mat im1, cv::Mat im2, vector<cv::Point
 }
 
 void StereoProcess::monocularTriangulate(Mat im1, Mat im2, vector<Point3f>&out3d){
-    Ptr<FeatureDetector> detector = xfeatures2d::SIFT::create(10000);
-    
     vector<KeyPoint> kp1, kp2;
-    detector->detect(im1, kp1);
-    detector->detect(im2, kp2);
+    monoSift->detect(im1, kp1);
+    monoSift->detect(im2, kp2);
 
     Mat desc1, desc2;
-    detector->compute(im1, kp1, desc1);
-    detector->compute(im2, kp2, desc2);
+    monoSift->compute(im1, kp1, desc1);
+    monoSift->compute(im2, kp2, desc2);
     desc1.convertTo(desc1, CV_32F);
     desc2.convertTo(desc2, CV_32F);
 
-    BFMatcher matcher;
     vector<vector<DMatch>> matches;
 
     matcher.knnMatch(desc1, desc2, matches,2);
@@ -251,8 +236,12 @@ void StereoProcess::reprojectDisparity(cv::Mat disp, vector<cv::Point3f>&reproje
 
 void StereoProcess::mainLoop(){
     Mat disp, normDisp;
-    for(int i=0; i<4000; i+=1){
+    const int nFrames = dataset->length();
+    for(int i=0; nFrames<0 || i<nFrames; i+=1){
         disp = stereoMatch(i);
+        if(disp.empty()){
+            break;
+        }
         normalize(disp, normDisp, 0, 255,cv::NORM_MINMAX,CV_8U);
         applyColorMap(normDisp, normDisp, COLORMAP_JET); 
         reprojectDisparity(disp, tri3dPoints, color3dMap);
@@ -298,11 +287,18 @@ void StereoProcess::pclPublish(vector<cv::Point3f>&pts3d, vector<cv::Point3f>&co
 
 int main(int argc, char **argv){
     ros::init(argc, argv, "StereoPublisher");
-    const char* impathL = "/media/gautham/Seagate Backup Plus Drive/Datasets/ColorSeq/dataset/sequences/00/image_2/%0.6d.png";
-    const char* impathR = "/media/gautham/Seagate Backup Plus Drive/Datasets/ColorSeq/dataset/sequences/00/image_3/%0.6d.png";
 
-    StereoProcess *stereo = new StereoProcess(impathL, impathR);
+    datasetOptions opt;
+    if(!parseDatasetArgs(argc, argv, opt)){
+        printDatasetUsage(argv[0]);
+        return 1;
+    }
+    std::shared_ptr<datasetSource> data = openDataset(opt);
+    if(!data){
+        printDatasetUsage(argv[0]);
+        return 1;
+    }
+
+    StereoProcess *stereo = new StereoProcess(data);
     stereo->mainLoop();
 }
-
-
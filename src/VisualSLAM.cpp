@@ -10,35 +10,42 @@ PART OF ROS STERO SLAM, UNDER MIT LICENSE.
 
 void visualSLAM::initSequence(){
     int iter = 0;
-    char FileName1[200], filename2[200];
-    sprintf(FileName1, lFptr, iter);
-    sprintf(filename2, rFptr, iter);
-
-    // Mat imL = imread(FileName1);
-    // Mat imR = imread(filename2);
+    // -1 for live sources, they run until the stream stops
+    const int nFrames = dataset->length();
 
     //initPangolin();
 
-    Mat imL = loadImageL(iter);
-    Mat imR = loadImageR(iter);
-
-    referenceImg = imL;
+    prefetcher->start(iter, nFrames);
+    stereoFrame &initFrame = fetchFrame(iter);
+    if(!curFrameOk){
+        cerr<<"yikes, failed to fetch the first frame of "<<dataset->describe()<<endl;
+        return;
+    }
 
-    vector<Point2f> ref2dFeatures;
-    vector<Point3f> ref3dCoords;
-    
+    referenceImg = initFrame.grayL;
+    referencePyr = initFrame.pyrL;
 
-    stereoTriangulate(imL, imR, ref3dCoords, ref2dFeatures);
+    // first frame is the world origin, camera and world coordinates agree
+    stereoTriangulate(initFrame, landmarks);
     poseGraph.initializeGraph();
+    vertexFrames.push_back(0);
     Mat R = Mat::zeros(3,3,CV_64F);
     R.at<double>(0,0) = 1.0; R.at<double>(1,1) = 1.0; R.at<double>(2,2) = 1.0;
     
-    keyFrame kf; kf.idx = 0; kf.ref3dCoords = ref3dCoords; kf.R = R; kf.t = Mat::zeros(1,3,CV_64F);
-    keyFrameHistory.reserve(4500);
-    keyFrameHistory.emplace_back(kf);
+    landmarks.recordObservations(0);
+    
+    keyFrame kf; kf.idx = 0; kf.vertex = 0; kf.ref3dCoords = landmarks.xyz; kf.rgb = landmarks.rgb; kf.R = R; kf.t = Mat::zeros(3,1,CV_64F);
+    framePose fp; fp.idx = 0; fp.keyFrame = 0; fp.R = kf.R; fp.t = kf.t;
+    keyFrameHistory.add(kf);
+    poseHistory.reserve(std::min((size_t)expectedFrames, poseWindow + poseWindow/8 + 1));
+    poseHistory.emplace_back(fp);
+    mapHistory.emplace_back(landmarks.xyz);
+    colorHistory.emplace_back(landmarks.rgb);
+    markKeyFrame(0, R, fp.t);
 
     Eigen::Isometry3d curPose = cvMat2Eigen(R,Mat::zeros(1,3,CV_64F));
     isoVector.emplace_back(curPose);
+    motion.update(Mat::zeros(3,1,CV_64F), Mat::zeros(3,1,CV_64F));
     
     cerr<<"\n\n"<<endl;
 
@@ -46,49 +53,59 @@ void visualSLAM::initSequence(){
     std::thread renderThread([&](){ 
         DrawTrajectory(isoVector, mapHistory, colorHistory);
     });
+    startPipeline();
 
     std::chrono::high_resolution_clock::time_point start, end;
     chrono::duration<double> tDelta;
     double FPS = 0;
 
-    for(int iter=1; iter<4500; iter++){
+    // reused every frame
+    vector<int> inliers;
+
+    for(int iter=1; nFrames<0 || iter<nFrames; iter++){
         //cout<<"PROCESSING FRAME "<<iter<<endl;
         start = std::chrono::high_resolution_clock::now();
 
-        currentImage = loadImageL(iter);
+        stereoFrame &frame = fetchFrame(iter);
+        if(!curFrameOk){
+            cerr<<"No frame "<<iter<<", stopping"<<endl;
+            break;
+        }
+        currentImage = frame.grayL;
+        currentPyr = frame.pyrL;
+
+        // the mapping thread closed a loop and moved the world, follow it
+        // before tracking against it
+        Eigen::Isometry3d correction;
+        while(worldCorrections.tryPop(correction)){
+            applyWorldCorrection(correction);
+            correctionsApplied++;
+        }
         
-        vector<Point3f> trked3dCoords; vector<Point2f> trked2dPts;
         Mat tvec,rvec;
-        vector<int> inliers;
 
-        PerspectiveNpointEstimation(referenceImg, currentImage, ref2dFeatures, ref3dCoords, trked2dPts, trked3dCoords,rvec, tvec, inliers);
+        PerspectiveNpointEstimation(landmarks, rvec, tvec, inliers);
         if(SHUTDOWN_FLAG){
             break;
         }
 
-        checkLoopDetectorStatus(currentImage,iter);
+        loopCandidate lc;
+        if(loopResults.tryPop(lc)){
+            LC_FLAG = true;
+            LCidx = lc.match;
+            LCquery = lc.query;
+            loopsClosed++;
+            loopLagFrames += iter - lc.query;
+            if(lc.query!=iter){
+                cerr<<"Closing loop found at "<<lc.query<<" on frame "<<iter<<endl;
+            }
+        }
         Mat R;
         Rodrigues(rvec, R);
 
         R = R.t();
         Mat t = -R*tvec;
 
-        if(LC_FLAG){
-            stageForPGO(R, t, R, t, true);
-            stageForPGO(R, t, R, t, false);
-            std::vector<Eigen::Isometry3d> trans = poseGraph.globalOptimize();
-            isoVector = trans;
-            Mat interT = Eigen2cvMat(trans[trans.size()-1]);
-            t = interT.t();
-            renderMutex.lock();
-            updateOdometry(trans);
-            renderMutex.unlock();
-        }
-        else{
-            stageForPGO(R, t, R, t, false);
-        }
-
-
 
         Mat pose4dTransform = Mat::zeros(3,4, CV_64F);
         R.col(0).copyTo(pose4dTransform.col(0));
@@ -107,90 +124,104 @@ void visualSLAM::initSequence(){
         inv4dTransform.row(1).copyTo(itx.row(1));
         inv4dTransform.row(2).copyTo(itx.row(2));
 
-
-        vector<Point3f> dr3d, tr3d; tr3d = trked3dCoords;
-        dr3d = update3dtransformation(tr3d, itx);
-
-        drw = drawDepthCMap(currentImage, dr3d, trked2dPts, inlierReferencePyrLKPts);
-
-
-
-        bool reloc = false;
-
-        if(inliers.size()<200 or LC_FLAG==true){
+        publishJob pj;
+        pj.idx = iter;
+        pj.gray = currentImage;
+        pj.color = frame.imL;
+        pj.R = R.clone();
+        pj.t = t.clone();
+        pj.invTransform = itx;
+        pj.pts3d = landmarks.xyz;
+        pj.pts2d = landmarks.uv;
+        pj.prevPts2d = inlierReferencePyrLKPts;
+        publishStage->tryPush(std::move(pj));
+
+        lastIter = iter;
+        lastT = t.clone();
+
+        mapJob mj;
+        mj.idx = iter;
+        mj.R = R.clone();
+        mj.t = t.clone();
+        mj.epoch = correctionsApplied;
+
+        keyFrameReason why = KF_FORCED;
+        if(!LC_FLAG){
+            why = kfPolicy->decide(gatherKeyFrameSignals(iter, R, t, inliers));
+        }
+        if(why!=KF_NONE){
             //cerr<<"ENTERING KEYFRAME AT "<<iter<<"... "<<"\n";
-            Mat i1 = loadImageL(iter); Mat i2 = loadImageR(iter);
-            insertKeyFrames(0, i1, i2, pose4dTransform, ref2dFeatures, ref3dCoords);
-
-            vector<Point3f> good3d = ref3dCoords;
-            vector<Point3f> goodColors = colors;
-
-            SORcloud(good3d, goodColors);
-
-            Mat Rotation = R.clone(); Mat translation = t.clone();
-            Eigen::Isometry3d curPose = cvMat2Eigen(Rotation,translation);
-
-            renderMutex.lock();
-            isoVector.emplace_back(curPose);
-            mapHistory.emplace_back(good3d);
-            colorHistory.emplace_back(goodColors);
-            renderMutex.unlock();
+            kfCount[why]++;
+            // triangulation stays here, the next frame tracks against it
+            const bool keepTracks = PERSIST_FLAG;
+            if(keepTracks){
+                // only tracks PnP agreed with carry over
+                keptMask.assign(landmarks.size(), 0);
+                for(int i : inliers){
+                    keptMask[i] = 1;
+                }
+                landmarks.compact(keptMask);
+            }
+            insertKeyFrames(0, frame, pose4dTransform, landmarks, mj.cloud, keepTracks);
+
+            // a closure rides on a keyframe job, those are never dropped.
+            // the graph is optimised on the mapping thread
+            if(LC_FLAG){
+                mj.loopMatch = LCidx;
+                mj.loopQuery = LCquery;
+            }
+            mj.keyframe = true;
+            mj.pose4dTransform = pose4dTransform;
+            mj.rgb = mapRgb;
+
+            markKeyFrame(iter, R, t);
+        }
 
-            Mat tcl = t.clone();
-            trajectory.emplace_back(tcl);
-            reloc = true;
+        framePose fp;
+        fp.idx = iter;
+        fp.R = mj.R;
+        fp.t = mj.t;
+        poseBacklog.emplace_back(fp);
+        mj.poses.swap(poseBacklog);
+        // keyframes are never dropped. pose records never wait, when the
+        // mapping queue is full they ride along with the next job
+        if(mj.keyframe){
+            mappingStage->push(std::move(mj));
         }
-        else{
-            ref3dCoords = trked3dCoords;
-            ref2dFeatures = trked2dPts;
+        else if(!mappingStage->tryHandOff(mj)){
+            poseBacklog.swap(mj.poses);
         }
 
-        if(cooldownTimer!=0){
-            cooldownTimer--;
+        // the place recognition database only sees keyframes, consecutive
+        // frames are near duplicates of each other
+        if(!LOOP_KF_FLAG || why!=KF_NONE){
+            loopJob lj;
+            lj.idx = iter;
+            lj.gray = currentImage;
+            // a full queue means detection is behind, the frame is skipped
+            // rather than holding up tracking
+            loopStage->tryPush(std::move(lj));
         }
+
         referenceImg = currentImage;
+        referencePyr.swap(currentPyr);
         LC_FLAG = false;
 
-        SORcloud(untransformed, colors);
-
-        keyFrame kf;
-        kf.idx = iter;
-        kf.R = R;
-        kf.t = t;
-        kf.ref3dCoords = untransformed;
-
-        if(reloc){
-            kf.retrack = true;
-        }
-        else{
-            kf.retrack = false;
-        }
-        
-        keyFrameHistory.emplace_back(kf);
-        Mat tr = t.clone();
-        Mat Rr = R.clone();
-
-        //rosPublish(mapHistory, tr,Rr);
-
-
-        t.convertTo(t, CV_32F);
-        //Mat frame = drawDeltas(currentImage, inlierReferencePyrLKPts, trked2dPts);
-        //Mat frame = drawDepthCMap(currentImage, )
-        Mat imCpy;
-        resize(drw, imCpy, Size(), 0.7, 0.7);
-        Mat reSizOG;
-        resize(currentImage, reSizOG, Size(), 0.7, 0.7);
-
         end = std::chrono::high_resolution_clock::now();
         tDelta = std::chrono::duration_cast<chrono::duration<double>>(end-start);
-
-        renderMutex.lock();
         trackFPS = 1/tDelta.count();
-        renderMutex.unlock();
 
+        if(iter%100==0){
+            printPipelineStats();
+        }
 
-        imshow("Debug", imCpy);
-        imshow("frame",reSizOG);
+        viewMutex.lock();
+        Mat imCpy = debugView, reSizOG = frameView;
+        viewMutex.unlock();
+        if(!imCpy.empty()){
+            imshow("Debug", imCpy);
+            imshow("frame",reSizOG);
+        }
         ros::spinOnce();
         int k = waitKey(1);
         if (k=='q'){
@@ -199,6 +230,14 @@ void visualSLAM::initSequence(){
         }
     }
 
+    stopPipeline();
+    // the mapping thread is gone, whatever never found room is recorded here
+    for(framePose &fp : poseBacklog){
+        recordPose(fp);
+    }
+    poseBacklog.clear();
+    printPipelineStats();
+
     cerr<<"Total map size :"<<mapPts.size()<<endl;
     poseGraph.saveStructure();
     //vector<Eigen::Isometry3d> res = poseGraph.globalOptimize();
@@ -207,31 +246,76 @@ void visualSLAM::initSequence(){
     renderThread.join();
 
     SHUTDOWN_FLAG = true;
-    rosPublish(mapHistory, trajectory[trajectory.size()-1], keyFrameHistory[keyFrameHistory.size()-1].R);
+    // trajectory only has keyframes after the first, fall back to the last
+    // tracked position and then to the origin
+    Mat finalT = !trajectory.empty() ? trajectory.back() : (!lastT.empty() ? lastT : Mat::zeros(3,1,CV_64F));
+    Mat finalR = !poseHistory.empty() ? poseHistory.back().R : Mat::eye(3,3,CV_64F);
+    rosPublish(mapHistory, finalT, finalR);
+    exportMap();
     imwrite("Trajectory.png",canvas);
     cerr<<"Trajectory Saved"<<endl;
     //DrawTrajectory(res,mapHistory,colorHistory);
 }
 
 
-int main(int argc, char **argv){
-    ros::init(argc, argv, "SLAM_node");
+void visualSLAM::startPipeline(){
+    loopStage->start();
+    mappingStage->start();
+    publishStage->start();
+}
 
-    const char* impathL = "/media/gautham/Seagate Backup Plus Drive/Datasets/ColorSeq/dataset/sequences/00/image_2/%0.6d.png";
-    const char* impathR = "/media/gautham/Seagate Backup Plus Drive/Datasets/ColorSeq/dataset/sequences/00/image_3/%0.6d.png";
-    std::string vocPath = "/home/gautham/Documents/Projects/LargeScaleMapping/orb_voc00.yml.gz";
+// each stage drains what is already queued before its thread exits
+void visualSLAM::stopPipeline(){
+    loopStage->stop();
+    mappingStage->stop();
+    publishStage->stop();
+}
 
-    vector<Point2f> ref2d; vector<Point3f> ref3d;
+void visualSLAM::printPipelineStats(){
+    const stageStats &l = loopStage->stats, &m = mappingStage->stats, &p = publishStage->stats;
+    fprintf(stderr, "pnp guided %d ransac %d, hypotheses %ld (%ld pre-rejected, last frame %d) | ",
+            guidedFrames, ransacFrames, pnpHypotheses, pnpPreRejected, pnpEngine.stats.hypotheses);
+    fprintf(stderr, "keyframes");
+    for(int r=KF_FORCED; r<KF_REASONS; r++){
+        fprintf(stderr, " %s %ld", keyFrameReasonName((keyFrameReason)r), kfCount[r]);
+    }
+    renderMutex.lock();
+    fprintf(stderr, " | kf store %zu (%.1f MB ram, %.1f MB spilled, %ld faults)",
+            keyFrameHistory.size(), keyFrameHistory.residentBytes()/1048576.0,
+            keyFrameHistory.spilledBytes()/1048576.0, keyFrameHistory.faults);
+    renderMutex.unlock();
+    Matx34d gt;
+    if(!lastT.empty() && dataset->groundTruthPose(lastIter, gt)){
+        const double dx = lastT.at<double>(0) - gt(0,3), dy = lastT.at<double>(1) - gt(1,3), dz = lastT.at<double>(2) - gt(2,3);
+        fprintf(stderr, " | gt error %.2f m", std::sqrt(dx*dx + dy*dy + dz*dz));
+    }
+    fprintf(stderr, " | ");
+    fprintf(stderr, "track %.1f fps | loop %.1f/s q %ld (max %ld) skipped %ld gated %ld db %ld, %ld closed (gt ok %ld wrong %ld) lag %.1f | map %.1f/s q %ld (max %ld) | publish %.1f/s skipped %ld\n",
+            (double)trackFPS,
+            l.throughput(), (long)l.depth, (long)l.maxDepth, (long)l.dropped,
+            (long)loopGated, (long)loopDbSize,
+            loopsClosed, (long)loopGtTrue, (long)loopGtFalse,
+            loopsClosed ? (double)loopLagFrames/loopsClosed : 0.0,
+            m.throughput(), (long)m.depth, (long)m.maxDepth,
+            p.throughput(), (long)p.dropped);
+}
+
+int main(int argc, char **argv){
+    ros::init(argc, argv, "SLAM_node");
 
-    visualSLAM Vsl(0, impathL, impathR, vocPath);
-    char FileName1[200], filename2[200];
-    sprintf(FileName1, impathL, 0);
-    sprintf(filename2, impathR, 0);
+    datasetOptions opt;
+    opt.vocabulary = "orb_voc00.yml.gz";
+    if(!parseDatasetArgs(argc, argv, opt)){
+        printDatasetUsage(argv[0]);
+        return 1;
+    }
+    std::shared_ptr<datasetSource> data = openDataset(opt);
+    if(!data){
+        printDatasetUsage(argv[0]);
+        return 1;
+    }
 
-    Mat im1 = imread(FileName1);
-    Mat im2 = imread(filename2);
-    //VO.stereoTriangulate(im1, im2, ref3d, ref2d);
-    //visualOdometry* VO = new visualOdometry(0, impathR, impathL);
+    visualSLAM Vsl(data, opt.vocabulary);
     Vsl.initSequence();
     return 0;
 }
@@ -11,91 +11,49 @@
 
 #include <bits/stdc++.h>
 
+#include "../include/vocabularyTrainer.h"
+
 using namespace std;
 using namespace cv;
 using namespace DBoW2;
 
-void changeStructure(const cv::Mat &plain, vector<cv::Mat> &out){
-    out.resize(plain.rows);
-    for(int i = 0; i < plain.rows; ++i){
-      out[i] = plain.row(i);
-    }
-}
-
-void loadFeatures(vector<vector<cv::Mat > > &features, int NIMAGES, vector<String> fSysHandle){
-    features.clear();
-    features.reserve(NIMAGES);
-
-    cv::Ptr<cv::ORB> orb = cv::ORB::create();
-
-    cout << "Extracting ORB features..." << endl;
-    for(int i = 0; i < NIMAGES; i+=1){
-        cout << "images/image" << i << ".png"<<endl;
-
-        cv::Mat image = cv::imread(fSysHandle[i], 0);
-        cv::Mat mask;
-        vector<cv::KeyPoint> keypoints;
-        cv::Mat descriptors;
-
-        orb->detectAndCompute(image, mask, keypoints, descriptors);
-
-        features.push_back(vector<cv::Mat >());
-        changeStructure(descriptors, features.back());
-    }
-}
-
-void testVocCreation(const vector<vector<cv::Mat > > &features, int NIMAGES)
-{
-  // branching factor and depth levels 
-  const int k = 9;
-  const int L = 6;
+// ORB on every image into a descriptor file next to the output, then the
+// vocabulary tree level by level. both stages run on a thread pool and the
+// descriptors stay on disk, so large sequences fit in memory
+bool trainVocabulary(const vector<string> &images, const string &featureFile, bool reuse,
+                     int nFeatures, int k, int L, int nThreads, const string &out){
   const WeightingType weight = TF_IDF;
   const ScoringType scoring = L1_NORM;
 
-  OrbVocabulary voc(k, L, weight, scoring);
+  threadPool pool(nThreads);
+  orbFeatureFile features;
+  if(!reuse || !features.open(featureFile)){
+    cout << "Extracting ORB features from " << images.size() << " images on " << pool.size() << " threads..." << endl;
+    if(!extractOrbFeatures(images, featureFile, nFeatures, pool) || !features.open(featureFile)){
+      return false;
+    }
+  }
+  cout << features.size() << " descriptors from " << features.images() << " images" << endl;
 
-  cout << "Creating a volptous " << k << "^" << L << " vocabulary..." << endl;
-  voc.create(features);
-  cout << "... done!" << endl;
+  vocabularyTrainer voc(k, L, weight, scoring);
+  cout << "Creating a " << k << "^" << L << " vocabulary..." << endl;
+  auto t0 = chrono::steady_clock::now();
+  if(!voc.train(features, pool)){
+    return false;
+  }
+  cout << "... done in " << chrono::duration<double>(chrono::steady_clock::now() - t0).count() << " s" << endl;
 
   cout << "Vocabulary information: " << endl
   << voc << endl << endl;
 
-  // lets do something with this vocabulary
-  cout << "Matching images against themselves (0 low, 1 high): " << endl;
-  BowVector v1, v2;
-
-  // for(int i = 0; i < NIMAGES; i++)
-  // { 
-  //   voc.transform(features[i], v1);
-  //   double MaxScore = 0; int bestMatch = 0;
-
-  //   for(int j = 0; j < NIMAGES/10; j++){
-  //     if(i==j) continue;
-  //     voc.transform(features[j], v2);
-  //     double score = voc.score(v1, v2);
-  //     if(score>MaxScore){
-  //       MaxScore = score;
-  //       bestMatch = j;
-  //     }
-  //     //cout << "Image " << i << " vs Image " << j << ": " << score << endl;
-  //   }
-  //   if(MaxScore>0.1){
-  //       cout<<"\n\nBEST MATCH BETWEEN IMAGES "<<i<<" , "<<bestMatch<<" WITH SCORE "<<MaxScore<<endl<<endl;
-  //   }
-  //   else{
-  //       cerr<<"Skippity skip "<<i<<endl;
-  //       continue;
-  //   }
-  //   if(std::abs(i-bestMatch)<10){
-  //     cout<<"FOUND ONLY LOCAL MATCHES"<<endl;
-  //   }
-  // }
-
-  // save the vocabulary to disk
-  cout << endl << "Saving vocabulary..." << endl;
-  voc.save("orb_voc.yml.gz");
+  // save the vocabulary to disk, DBoW2 YAML unless a .bin is asked for
+  cout << endl << "Saving vocabulary to " << out << endl;
+  if(out.size()>4 && out.compare(out.size()-4, 4, ".bin")==0){
+    return voc.saveBinary(out);
+  }
+  voc.save(out);
   cout << "Done" << endl;
+  return true;
 }
 
 void orbDetect(Mat im, vector<KeyPoint>&keys, Mat descs){
@@ -105,17 +63,50 @@ void orbDetect(Mat im, vector<KeyPoint>&keys, Mat descs){
     detector->compute(im, keys, descs);
 }
 
+static void printUsage(const char *name){
+    cerr<<"usage : "<<name<<" <image glob> [--out orb_voc.yml.gz|.bin] [--features orb_features.bin] [--reuse]"<<endl;
+    cerr<<"         [--k 9] [--L 6] [--orb 500] [--threads N] [--show]"<<endl;
+    cerr<<"e.g.    "<<name<<" \"<dataset>/sequences/00/image_0/*.png\""<<endl;
+}
 
-int main(){
-    vector<cv::String> indices;
-    glob("/media/gautham/Seagate Backup Plus Drive/Datasets/dataset/sequences/08/image_0/*.png", indices, false);
-    
-    Mat prevImg;
-    vector<vector<Mat>> orbFeatures;
+int main(int argc, char **argv){
+    string pattern;
+    string out = "orb_voc.yml.gz", featureFile = "orb_features.bin";
+    int k = 9, L = 6, nFeatures = 500;
+    int nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    bool reuse = false, show = false;
+    for(int i=1; i<argc; i++){
+        const string a = argv[i];
+        const bool more = i+1<argc;
+        if(a=="--out" && more) out = argv[++i];
+        else if(a=="--features" && more) featureFile = argv[++i];
+        else if(a=="--k" && more) k = atoi(argv[++i]);
+        else if(a=="--L" && more) L = atoi(argv[++i]);
+        else if(a=="--orb" && more) nFeatures = atoi(argv[++i]);
+        else if(a=="--threads" && more) nThreads = atoi(argv[++i]);
+        else if(a=="--reuse") reuse = true;
+        else if(a=="--show") show = true;
+        else if(i==1 && a.compare(0, 2, "--")!=0) pattern = a;
+        else{
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if(pattern.empty()){
+        printUsage(argv[0]);
+        return 1;
+    }
 
-    loadFeatures(orbFeatures, indices.size(), indices);
+    vector<cv::String> indices;
+    glob(pattern, indices, false);
+    vector<string> images(indices.begin(), indices.end());
 
-    testVocCreation(orbFeatures, indices.size());
+    if(!trainVocabulary(images, featureFile, reuse, nFeatures, k, L, nThreads, out)){
+        return 1;
+    }
+    if(!show){
+        return 0;
+    }
 
     for(size_t i=0; i< indices.size(); i+=1){
         cout<<"Processing Frame "<<i<<endl;
@@ -132,4 +123,5 @@ int main(){
             break;
         }
     }
-}
\ No newline at end of file
+    return 0;
+}
@@ -0,0 +1,301 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/binaryVocabulary.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace DBoW2;
+
+static const uint64_t sectionAlign = 64;
+
+static uint64_t alignUp(uint64_t x){
+    return (x + sectionAlign - 1)/sectionAlign*sectionAlign;
+}
+
+static bool writeAt(FILE *fp, uint64_t &cursor, uint64_t offset, const void *data, size_t bytes){
+    if(offset>cursor){
+        vector<char> pad(offset - cursor, 0);
+        if(fwrite(pad.data(), 1, pad.size(), fp)!=pad.size()){
+            return false;
+        }
+        cursor = offset;
+    }
+    if(bytes && fwrite(data, 1, bytes, fp)!=bytes){
+        return false;
+    }
+    cursor += bytes;
+    return true;
+}
+
+bool binaryOrbVocabulary::flatten(vector<binaryVocNode> &nodes, vector<uint32_t> &children,
+                                  vector<packedDescriptor> &desc) const{
+    nodes.assign(m_nodes.size(), binaryVocNode());
+    children.clear();
+    children.reserve(m_nodes.size());
+    desc.clear();
+    desc.reserve(m_nodes.size());
+    for(size_t i=0; i<m_nodes.size(); i++){
+        const Node &n = m_nodes[i];
+        binaryVocNode &b = nodes[i];
+        b.weight = n.weight;
+        b.parent = i==0 ? -1 : (int32_t)n.parent;
+        b.wordId = n.isLeaf() ? (int32_t)n.word_id : -1;
+        b.firstChild = children.size();
+        b.nChildren = n.children.size();
+        for(NodeId c : n.children){
+            if(c>=m_nodes.size() || m_nodes[c].descriptor.total()*m_nodes[c].descriptor.elemSize()!=(size_t)FORB::L){
+                cerr<<"Node "<<c<<" has no "<<FORB::L<<" byte descriptor"<<endl;
+                return false;
+            }
+            const cv::Mat &d = m_nodes[c].descriptor;
+            children.push_back(c);
+            desc.push_back(packDescriptor(d.isContinuous() ? d.data : d.clone().data));
+        }
+    }
+    return true;
+}
+
+bool binaryOrbVocabulary::saveBinary(const string &path) const{
+    if(m_nodes.empty()){
+        cerr<<"Refusing to write an empty vocabulary"<<endl;
+        return false;
+    }
+    vector<binaryVocNode> nodes;
+    vector<uint32_t> children;
+    vector<packedDescriptor> desc;
+    if(!flatten(nodes, children, desc)){
+        return false;
+    }
+
+    binaryVocHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BINARY_VOC_MAGIC, 8);
+    h.version = BINARY_VOC_VERSION;
+    h.k = m_k;
+    h.L = m_L;
+    h.weighting = (int32_t)m_weighting;
+    h.scoring = (int32_t)m_scoring;
+    h.nNodes = nodes.size();
+    h.nWords = m_words.size();
+    h.nChildren = children.size();
+    h.descBytes = sizeof(packedDescriptor);
+    h.nodesOffset = alignUp(sizeof(h));
+    h.childrenOffset = alignUp(h.nodesOffset + nodes.size()*sizeof(binaryVocNode));
+    h.descOffset = alignUp(h.childrenOffset + children.size()*sizeof(uint32_t));
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if(!fp){
+        cerr<<"Could not open "<<path<<" for writing"<<endl;
+        return false;
+    }
+    uint64_t cursor = 0;
+    bool ok = writeAt(fp, cursor, 0, &h, sizeof(h));
+    ok = ok && writeAt(fp, cursor, h.nodesOffset, nodes.data(), nodes.size()*sizeof(binaryVocNode));
+    ok = ok && writeAt(fp, cursor, h.childrenOffset, children.data(), children.size()*sizeof(uint32_t));
+    ok = ok && writeAt(fp, cursor, h.descOffset, desc.data(), desc.size()*sizeof(packedDescriptor));
+    ok &= fclose(fp)==0;
+    if(!ok){
+        cerr<<"Failed writing "<<path<<endl;
+    }
+    return ok;
+}
+
+bool binaryOrbVocabulary::pack(){
+    if(m_nodes.empty() || !flatten(ownNodes, ownChildren, ownDesc)){
+        flatNodes = NULL;
+        return false;
+    }
+    flatNodes = ownNodes.data();
+    flatChildren = ownChildren.data();
+    flatDesc = ownDesc.data();
+    return true;
+}
+
+// same walk as TemplatedVocabulary::transform, ties go to the first child
+void binaryOrbVocabulary::transform(const FORB::TDescriptor &feature, WordId &id,
+                                    WordValue &weight, NodeId *nid, int levelsup) const{
+    if(!flatNodes || feature.total()*feature.elemSize()!=sizeof(packedDescriptor) || !feature.isContinuous()){
+        OrbVocabulary::transform(feature, id, weight, nid, levelsup);
+        return;
+    }
+    const uint32_t node = walk(packDescriptor(feature.data), nid, levelsup);
+    id = m_nodes[node].word_id;
+    weight = m_nodes[node].weight;
+}
+
+uint32_t binaryOrbVocabulary::walk(const packedDescriptor &q, NodeId *nid, int levelsup) const{
+    const int nidLevel = m_L - levelsup;
+    if(nidLevel<=0 && nid){
+        *nid = 0;
+    }
+    uint32_t node = 0;
+    int level = 0;
+    if(flatNodes[0].nChildren==0){
+        return 0;
+    }
+    do{
+        level++;
+        const binaryVocNode &b = flatNodes[node];
+        node = flatChildren[b.firstChild + nearestHamming(q, flatDesc + b.firstChild, b.nChildren)];
+        if(nid && level==nidLevel){
+            *nid = node;
+        }
+    }while(flatNodes[node].nChildren>0);
+    return node;
+}
+
+// mappings are never released, see the note on binaryOrbVocabulary
+static mutex mappingLock;
+static map<string, pair<const unsigned char*, size_t>> mappings;
+
+static bool mapFile(const string &path, const unsigned char *&base, size_t &bytes){
+    lock_guard<mutex> lk(mappingLock);
+    auto it = mappings.find(path);
+    if(it!=mappings.end()){
+        base = it->second.first;
+        bytes = it->second.second;
+        return true;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd<0){
+        cerr<<"Could not open vocabulary "<<path<<endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st)!=0 || (size_t)st.st_size<sizeof(binaryVocHeader)){
+        ::close(fd);
+        cerr<<"Vocabulary "<<path<<" is truncated"<<endl;
+        return false;
+    }
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(ptr==MAP_FAILED){
+        cerr<<"mmap failed on "<<path<<endl;
+        return false;
+    }
+    base = (const unsigned char*)ptr;
+    bytes = st.st_size;
+    mappings[path] = make_pair(base, bytes);
+    return true;
+}
+
+bool binaryOrbVocabulary::loadBinary(const string &path){
+    const unsigned char *base = NULL;
+    size_t bytes = 0;
+    if(!mapFile(path, base, bytes)){
+        return false;
+    }
+    binaryVocHeader h;
+    memcpy(&h, base, sizeof(h));
+    if(memcmp(h.magic, BINARY_VOC_MAGIC, 8)!=0 || h.version!=BINARY_VOC_VERSION || h.descBytes!=(uint32_t)FORB::L ||
+       h.nNodes==0 || h.nodesOffset + (uint64_t)h.nNodes*sizeof(binaryVocNode)>bytes ||
+       h.childrenOffset + (uint64_t)h.nChildren*sizeof(uint32_t)>bytes ||
+       h.descOffset + (uint64_t)h.nChildren*h.descBytes>bytes){
+        cerr<<"Vocabulary "<<path<<" is not a version "<<BINARY_VOC_VERSION<<" binary vocabulary"<<endl;
+        return false;
+    }
+    const binaryVocNode *nodes = (const binaryVocNode*)(base + h.nodesOffset);
+    const uint32_t *children = (const uint32_t*)(base + h.childrenOffset);
+    // the mapping is read only, DBoW2 never writes node descriptors
+    // outside of create()
+    unsigned char *desc = const_cast<unsigned char*>(base + h.descOffset);
+    flatNodes = NULL;
+
+    m_k = h.k;
+    m_L = h.L;
+    m_weighting = (WeightingType)h.weighting;
+    m_scoring = (ScoringType)h.scoring;
+    createScoringObject();
+
+    m_nodes.clear();
+    m_nodes.resize(h.nNodes);
+    m_words.clear();
+    m_words.resize(h.nWords);
+    for(uint32_t i=0; i<h.nNodes; i++){
+        const binaryVocNode &b = nodes[i];
+        Node &n = m_nodes[i];
+        bool broken = b.firstChild + (uint64_t)b.nChildren>h.nChildren ||
+                      (b.wordId>=0 && (uint32_t)b.wordId>=h.nWords);
+        for(uint32_t j=0; !broken && j<b.nChildren; j++){
+            broken = children[b.firstChild + j]>=h.nNodes;
+        }
+        if(broken){
+            cerr<<"Vocabulary "<<path<<" has a broken node "<<i<<endl;
+            m_nodes.clear();
+            m_words.clear();
+            return false;
+        }
+        n.id = i;
+        n.weight = b.weight;
+        n.parent = b.parent<0 ? 0 : b.parent;
+        n.children.assign(children + b.firstChild, children + b.firstChild + b.nChildren);
+        for(uint32_t j=b.firstChild; j<b.firstChild + b.nChildren; j++){
+            m_nodes[children[j]].descriptor = cv::Mat(1, FORB::L, CV_8U, desc + (size_t)j*FORB::L);
+        }
+        if(b.wordId>=0){
+            n.word_id = b.wordId;
+            m_words[b.wordId] = &n;
+        }
+    }
+    ownNodes.clear();
+    ownChildren.clear();
+    ownDesc.clear();
+    flatNodes = nodes;
+    flatChildren = children;
+    flatDesc = (const packedDescriptor*)desc;
+    return true;
+}
+
+bool isBinaryVocabulary(const string &path){
+    char magic[8];
+    FILE *fp = fopen(path.c_str(), "rb");
+    if(!fp){
+        return false;
+    }
+    const bool ok = fread(magic, 1, 8, fp)==8 && memcmp(magic, BINARY_VOC_MAGIC, 8)==0;
+    fclose(fp);
+    return ok;
+}
+
+shared_ptr<OrbVocabulary> loadOrbVocabulary(const string &path){
+    if(isBinaryVocabulary(path)){
+        shared_ptr<binaryOrbVocabulary> voc(new binaryOrbVocabulary());
+        if(!voc->loadBinary(path)){
+            return nullptr;
+        }
+        return voc;
+    }
+    shared_ptr<binaryOrbVocabulary> voc(new binaryOrbVocabulary());
+    try{
+        voc->load(path);
+    }
+    catch(const string &e){
+        cerr<<e<<endl;
+        return nullptr;
+    }
+    catch(const std::exception &e){
+        cerr<<"Could not load vocabulary "<<path<<" : "<<e.what()<<endl;
+        return nullptr;
+    }
+    if(voc->empty()){
+        cerr<<"Vocabulary "<<path<<" is empty"<<endl;
+        return nullptr;
+    }
+    voc->pack();
+    return voc;
+}
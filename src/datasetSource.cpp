@@ -0,0 +1,267 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/datasetSource.h"
+#include "../include/rosStereoSource.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "opencv2/highgui/highgui.hpp"
+
+using namespace std;
+using namespace cv;
+
+double datasetSource::timestamp(int idx) const{
+    if(idx>=0 && idx<(int)times.size()){
+        return times[idx];
+    }
+    return idx/frameRate;
+}
+
+// sources that hand out both images anyway just load the pair again
+bool datasetSource::loadRight(int idx, stereoFrame &frame){
+    stereoFrame full;
+    if(!load(idx, full)){
+        return false;
+    }
+    frame.imR = full.imR;
+    return frame.imR.data!=nullptr;
+}
+
+int datasetSource::length() const{
+    const int n = size();
+    if(frameLimit<0){
+        return n;
+    }
+    return n<0 ? frameLimit : std::min(n, frameLimit);
+}
+
+bool datasetSource::groundTruthPose(int idx, Matx34d &pose) const{
+    if(idx<0 || idx>=(int)groundTruth.size()){
+        return false;
+    }
+    pose = groundTruth[idx];
+    return true;
+}
+
+double datasetSource::groundTruthScale(int idx) const{
+    if(idx<1 || idx>=(int)groundTruth.size()){
+        return 0;
+    }
+    const Matx34d &a = groundTruth[idx-1], &b = groundTruth[idx];
+    const double dx = b(0,3)-a(0,3), dy = b(1,3)-a(1,3), dz = b(2,3)-a(2,3);
+    return std::sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+// one 3x4 row major pose per line
+bool datasetSource::loadGroundTruth(const string &posesFile){
+    ifstream in(posesFile);
+    if(!in.is_open()){
+        cerr<<"Unable to open ground truth "<<posesFile<<endl;
+        return false;
+    }
+    groundTruth.clear();
+    string line;
+    while(getline(in, line)){
+        istringstream ss(line);
+        Matx34d p;
+        int j = 0;
+        for(; j<12 && (ss>>p.val[j]); j++){}
+        if(j==12){
+            groundTruth.push_back(p);
+        }
+    }
+    return !groundTruth.empty();
+}
+
+static bool isFile(const string &path){
+    struct stat st;
+    return stat(path.c_str(), &st)==0 && S_ISREG(st.st_mode);
+}
+
+static bool isDir(const string &path){
+    struct stat st;
+    return stat(path.c_str(), &st)==0 && S_ISDIR(st.st_mode);
+}
+
+kittiSource::kittiSource(const string &sequenceDir, bool gray) : dir(sequenceDir){
+    if(!dir.empty() && dir[dir.size()-1]!='/'){
+        dir += "/";
+    }
+    leftDir = dir + (gray ? "image_0/" : "image_2/");
+    rightDir = dir + (gray ? "image_1/" : "image_3/");
+
+    calib.readKitti(dir + "calib.txt", gray);
+
+    ifstream in(dir + "times.txt");
+    double t;
+    while(in>>t){
+        times.push_back(t);
+    }
+    if(!times.empty()){
+        nFrames = (int)times.size();
+    }
+    else{
+        while(isFile(imagePath(leftDir, nFrames))){
+            nFrames++;
+        }
+    }
+}
+
+string kittiSource::imagePath(const string &camDir, int idx) const{
+    char name[16];
+    snprintf(name, sizeof(name), "%06d.png", idx);
+    return camDir + name;
+}
+
+bool kittiSource::load(int idx, stereoFrame &frame){
+    if(idx<0 || idx>=nFrames){
+        return false;
+    }
+    frame.idx = idx;
+    frame.imL = imread(imagePath(leftDir, idx));
+    if(lazyRight){
+        return frame.imL.data!=nullptr;
+    }
+    return frame.imL.data && loadRight(idx, frame);
+}
+
+bool kittiSource::loadRight(int idx, stereoFrame &frame){
+    if(idx<0 || idx>=nFrames){
+        return false;
+    }
+    // right image is never coloured, let libpng hand back luma directly
+    frame.imR = imread(imagePath(rightDir, idx), lumaRight ? IMREAD_GRAYSCALE : IMREAD_COLOR);
+    return frame.imR.data!=nullptr;
+}
+
+string kittiSource::describe() const{
+    ostringstream ss;
+    ss<<"KITTI "<<dir<<" ("<<nFrames<<" frames)";
+    return ss.str();
+}
+
+bool frameCacheSource::open(const string &file){
+    if(!reader.open(file)){
+        return false;
+    }
+    path = file;
+    const frameCacheHeader &h = reader.info();
+    if(h.fx>0 && h.baseline>0){
+        calib.fx = h.fx; calib.fy = h.fy;
+        calib.cx = h.cx; calib.cy = h.cy;
+        calib.baseline = h.baseline;
+    }
+    return true;
+}
+
+bool frameCacheSource::load(int idx, stereoFrame &frame){
+    reader.prefetch(idx);
+    frame.idx = idx;
+    return reader.getFrame(idx, frame);
+}
+
+void printDatasetUsage(const char *prog){
+    cerr<<"usage : "<<prog<<" [<kitti sequence dir | file.fcache>] [options]"<<endl;
+    cerr<<"  --kitti DIR          KITTI odometry sequence (image_2/3, calib.txt, times.txt)"<<endl;
+    cerr<<"  --gray               use image_0/image_1 instead"<<endl;
+    cerr<<"  --cache FILE         packed frame cache from frameCacheConverter"<<endl;
+    cerr<<"  --ros LEFT RIGHT     live rectified image topics"<<endl;
+    cerr<<"  --ros-info LEFT RIGHT  camera_info topics for the calibration"<<endl;
+    cerr<<"  --poses FILE         ground truth poses, KITTI format"<<endl;
+    cerr<<"  --voc FILE           ORB vocabulary for loop detection"<<endl;
+    cerr<<"  --frames N           stop after N frames"<<endl;
+}
+
+bool parseDatasetArgs(int argc, char **argv, datasetOptions &opt){
+    for(int i=1; i<argc; i++){
+        const string a = argv[i];
+        const int left = argc - 1 - i;
+        if(a=="--kitti" && left>=1){
+            opt.kittiDir = argv[++i];
+        }
+        else if(a=="--cache" && left>=1){
+            opt.cacheFile = argv[++i];
+        }
+        else if(a=="--ros" && left>=2){
+            opt.leftTopic = argv[++i];
+            opt.rightTopic = argv[++i];
+        }
+        else if(a=="--ros-info" && left>=2){
+            opt.leftInfoTopic = argv[++i];
+            opt.rightInfoTopic = argv[++i];
+        }
+        else if(a=="--poses" && left>=1){
+            opt.posesFile = argv[++i];
+        }
+        else if(a=="--voc" && left>=1){
+            opt.vocabulary = argv[++i];
+        }
+        else if(a=="--frames" && left>=1){
+            opt.maxFrames = atoi(argv[++i]);
+        }
+        else if(a=="--gray"){
+            opt.gray = true;
+        }
+        else if(i==1 && a.compare(0, 2, "--")!=0){
+            if(isDir(a)){
+                opt.kittiDir = a;
+            }
+            else{
+                opt.cacheFile = a;
+            }
+        }
+        else if(a.compare(0, 2, "__")==0){
+            // roslaunch remappings (__name:=, __log:=)
+            continue;
+        }
+        else{
+            cerr<<"unknown or incomplete argument "<<a<<endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+shared_ptr<datasetSource> openDataset(const datasetOptions &opt){
+    shared_ptr<datasetSource> src;
+    if(!opt.cacheFile.empty()){
+        shared_ptr<frameCacheSource> cache(new frameCacheSource());
+        if(!cache->open(opt.cacheFile)){
+            cerr<<"Can't open frame cache "<<opt.cacheFile<<endl;
+            return nullptr;
+        }
+        src = cache;
+    }
+    else if(!opt.kittiDir.empty()){
+        shared_ptr<kittiSource> kitti(new kittiSource(opt.kittiDir, opt.gray));
+        if(kitti->size()==0){
+            cerr<<"No frames found under "<<opt.kittiDir<<endl;
+            return nullptr;
+        }
+        src = kitti;
+    }
+    else if(!opt.leftTopic.empty()){
+        src.reset(new rosStereoSource(opt.leftTopic, opt.rightTopic, opt.leftInfoTopic, opt.rightInfoTopic));
+    }
+    else{
+        cerr<<"No dataset given"<<endl;
+        return nullptr;
+    }
+
+    if(!opt.posesFile.empty()){
+        src->loadGroundTruth(opt.posesFile);
+    }
+    src->frameLimit = opt.maxFrames;
+    return src;
+}
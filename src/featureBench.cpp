@@ -0,0 +1,145 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <new>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/features2d.hpp>
+#include "opencv2/highgui/highgui.hpp"
+
+#include "../include/featureExtraction.h"
+
+using namespace std;
+using namespace cv;
+
+// every C++ heap allocation in the process goes through here so we can count
+// them. Mat pixel/descriptor buffers use cv::fastMalloc and aren't seen, so the
+// numbers are detector/matcher objects, keypoint vectors and matcher internals
+static std::atomic<long> allocCount(0);
+static std::atomic<long> allocBytes(0);
+
+void* operator new(size_t n){
+    allocCount++;
+    allocBytes += n;
+    void *p = malloc(n ? n : 1);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void *p) noexcept{
+    free(p);
+}
+void* operator new[](size_t n){
+    return operator new(n);
+}
+void operator delete[](void *p) noexcept{
+    free(p);
+}
+
+// what visualSLAM used to do on every frame: sparse stereo matching and the
+// loop detector ORB pass, with detectors and matchers built on the spot
+static void perCallFrame(const Mat &imL, const Mat &imR, vector<Point2f> &pt1, vector<Point2f> &pt2){
+    pt1.clear(); pt2.clear();
+    Ptr<FeatureDetector> detector = ORB::create(1000);
+    vector<KeyPoint> kp1, kp2;
+    Mat desc1, desc2;
+
+    std::thread left([&](){
+        detector->detect(imL, kp1);
+        detector->compute(imL, kp1, desc1);
+    });
+    std::thread right([&](){
+        detector->detect(imR, kp2);
+        detector->compute(imR, kp2, desc2);
+    });
+    left.join();
+    right.join();
+
+    desc1.convertTo(desc1, CV_32F);
+    desc2.convertTo(desc2, CV_32F);
+
+    BFMatcher matcher;
+    vector<vector<DMatch>> matches;
+    matcher.knnMatch(desc1, desc2, matches, 2);
+    for(size_t i=0; i<matches.size(); i++){
+        if(matches[i].size()<2) continue;
+        DMatch &m = matches[i][0]; DMatch &n = matches[i][1];
+        if(m.distance<0.8*n.distance){
+            pt1.emplace_back(kp1[m.queryIdx].pt);
+            pt2.emplace_back(kp2[m.trainIdx].pt);
+        }
+    }
+
+    Ptr<FeatureDetector> orb = ORB::create();
+    vector<KeyPoint> kp;
+    Mat desc;
+    orb->detectAndCompute(imL, Mat(), kp, desc);
+}
+
+static void persistentFrame(featureExtractor &fx, const Mat &imL, const Mat &imR, vector<Point2f> &pt1, vector<Point2f> &pt2){
+    fx.matchStereo(imL, imR, pt1, pt2);
+    vector<KeyPoint> kp;
+    Mat desc;
+    fx.extractLoopFeatures(imL, kp, desc);
+}
+
+static Mat syntheticFrame(int seed){
+    Mat im(376, 1241, CV_8UC1);
+    RNG rng(seed);
+    rng.fill(im, RNG::UNIFORM, 0, 255);
+    GaussianBlur(im, im, Size(5,5), 1.5);
+    return im;
+}
+
+int main(int argc, char **argv){
+    const int frames = 50;
+    Mat imL, imR;
+    if(argc>2){
+        imL = imread(argv[1], IMREAD_GRAYSCALE);
+        imR = imread(argv[2], IMREAD_GRAYSCALE);
+    }
+    if(!imL.data || !imR.data){
+        cerr<<"usage : "<<argv[0]<<" [left.png right.png], using synthetic frames"<<endl;
+        imL = syntheticFrame(1);
+        imR = syntheticFrame(2);
+    }
+
+    vector<Point2f> pt1, pt2;
+    pt1.reserve(2000); pt2.reserve(2000);
+
+    // warm up both paths so one time lazy init inside OpenCV isn't counted
+    perCallFrame(imL, imR, pt1, pt2);
+    featureExtractor fx(1000);
+    persistentFrame(fx, imL, imR, pt1, pt2);
+
+    long c0 = allocCount, b0 = allocBytes;
+    auto t0 = chrono::high_resolution_clock::now();
+    for(int i=0; i<frames; i++){
+        perCallFrame(imL, imR, pt1, pt2);
+    }
+    auto t1 = chrono::high_resolution_clock::now();
+    long c1 = allocCount, b1 = allocBytes;
+    for(int i=0; i<frames; i++){
+        persistentFrame(fx, imL, imR, pt1, pt2);
+    }
+    auto t2 = chrono::high_resolution_clock::now();
+    long c2 = allocCount, b2 = allocBytes;
+
+    cout<<"                 allocs/frame   KB/frame   ms/frame"<<endl;
+    cout<<"per call objects : "<<(c1-c0)/frames<<"\t"<<(b1-b0)/frames/1024<<"\t"
+        <<chrono::duration<double, std::milli>(t1-t0).count()/frames<<endl;
+    cout<<"persistent       : "<<(c2-c1)/frames<<"\t"<<(b2-b1)/frames/1024<<"\t"
+        <<chrono::duration<double, std::milli>(t2-t1).count()/frames<<endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/featureExtraction.h"
+
+#include <algorithm>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+featureExtractor::featureExtractor(int nStereoFeatures)
+    : rightWorker(1){
+    loopOrb = ORB::create();
+    // one instance per image so both sides can run at once
+    stereoOrbL = ORB::create(nStereoFeatures);
+    stereoOrbR = ORB::create(nStereoFeatures);
+    matcher = makePtr<BFMatcher>(NORM_HAMMING);
+}
+
+void featureExtractor::extractLoopFeatures(const Mat &img, vector<KeyPoint> &kp, Mat &desc){
+    desc.release();
+    loopOrb->detectAndCompute(img, noArray(), kp, desc);
+}
+
+void featureExtractor::matchStereo(const Mat &imL, const Mat &imR,
+                                   vector<Point2f> &pt1, vector<Point2f> &pt2, float ratio){
+    pt1.clear(); pt2.clear();
+
+    std::future<void> right = rightWorker.enqueue([&](){
+        stereoOrbR->detectAndCompute(imR, noArray(), kpR, descR);
+    });
+    stereoOrbL->detectAndCompute(imL, noArray(), kpL, descL);
+    right.get();
+
+    if(descL.empty() || descR.empty()){
+        return;
+    }
+    matcher->knnMatch(descL, descR, knn, 2);
+
+    for(size_t i=0; i<knn.size(); i++){
+        if(knn[i].size()<2){
+            continue;
+        }
+        DMatch &m = knn[i][0]; DMatch &n = knn[i][1];
+        if(m.distance<ratio*n.distance){
+            pt1.emplace_back(kpL[m.queryIdx].pt);
+            pt2.emplace_back(kpR[m.trainIdx].pt);
+        }
+    }
+}
+
+void featureExtractor::bucketedKeypoints(const Mat &img, vector<Point2f> &pts, const bucketParams &params){
+    pts.clear();
+    Mat gray = img;
+    if(img.channels()==3){
+        cvtColor(img, lumaScratch, COLOR_BGR2GRAY);
+        gray = lumaScratch;
+    }
+    FAST(gray, corners, params.fastThreshold, true);
+
+    if(params.shiTomasi){
+        cornerMinEigenVal(gray, eig, 3);
+        for(KeyPoint &kp : corners){
+            kp.response = eig.at<float>(cvRound(kp.pt.y), cvRound(kp.pt.x));
+        }
+    }
+
+    if(params.useAnms){
+        size_t n = 0;
+        for(size_t i=0; i<corners.size(); i++){
+            const Point2f &p = corners[i].pt;
+            if(p.x<params.border || p.y<params.border ||
+               p.x>=gray.cols-params.border || p.y>=gray.rows-params.border){
+                continue;
+            }
+            corners[n++] = corners[i];
+        }
+        corners.resize(n);
+        sscNonMaximalSuppression(corners, params.totalBudget, gray.cols, gray.rows);
+        for(const KeyPoint &kp : corners){
+            pts.emplace_back(kp.pt);
+        }
+        return;
+    }
+
+    const int gridW = (gray.cols + params.cellSize - 1)/params.cellSize;
+    const int gridH = (gray.rows + params.cellSize - 1)/params.cellSize;
+    cells.resize(gridW*gridH);
+    for(vector<int> &c : cells){
+        c.clear();
+    }
+    for(size_t i=0; i<corners.size(); i++){
+        const Point2f &p = corners[i].pt;
+        if(p.x<params.border || p.y<params.border ||
+           p.x>=gray.cols-params.border || p.y>=gray.rows-params.border){
+            continue;
+        }
+        int cx = (int)p.x/params.cellSize, cy = (int)p.y/params.cellSize;
+        cells[cy*gridW + cx].emplace_back(i);
+    }
+
+    // strongest first inside each cell, only the first perCellCap matter
+    auto stronger = [this](int a, int b){ return corners[a].response>corners[b].response; };
+    for(vector<int> &c : cells){
+        size_t keep = std::min(c.size(), (size_t)params.perCellCap);
+        std::partial_sort(c.begin(), c.begin()+keep, c.end(), stronger);
+        c.resize(keep);
+    }
+
+    for(int r=0; r<params.perCellCap && (int)pts.size()<params.totalBudget; r++){
+        roundIdx.clear();
+        for(const vector<int> &c : cells){
+            if((int)c.size()>r){
+                roundIdx.emplace_back(c[r]);
+            }
+        }
+        if(roundIdx.empty()){
+            break;
+        }
+        int room = params.totalBudget - (int)pts.size();
+        if((int)roundIdx.size()>room){
+            std::nth_element(roundIdx.begin(), roundIdx.begin()+room, roundIdx.end(), stronger);
+            roundIdx.resize(room);
+        }
+        for(int i : roundIdx){
+            pts.emplace_back(corners[i].pt);
+        }
+    }
+}
@@ -0,0 +1,198 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/frameCache.h"
+
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+frameCacheWriter::~frameCacheWriter(){
+    if(fp){
+        close();
+    }
+}
+
+bool frameCacheWriter::open(const string &path, int pageSize){
+    fp = fopen(path.c_str(), "wb");
+    if(!fp){
+        cerr<<"Could not open frame cache "<<path<<" for writing"<<endl;
+        return false;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_CACHE_MAGIC, 8);
+    header.version = FRAME_CACHE_VERSION;
+    header.pageSize = pageSize;
+    index.clear();
+
+    // placeholder, rewritten on close once the index offset is known
+    if(fwrite(&header, sizeof(header), 1, fp)!=1){
+        return false;
+    }
+    cursor = sizeof(header);
+    return padToPage();
+}
+
+void frameCacheWriter::setCalibration(double fx, double fy, double cx, double cy, double baseline){
+    header.fx = fx; header.fy = fy;
+    header.cx = cx; header.cy = cy;
+    header.baseline = baseline;
+}
+
+bool frameCacheWriter::padToPage(){
+    uint64_t rem = cursor % header.pageSize;
+    if(rem==0){
+        return true;
+    }
+    vector<char> pad(header.pageSize - rem, 0);
+    if(fwrite(pad.data(), 1, pad.size(), fp)!=pad.size()){
+        return false;
+    }
+    cursor += pad.size();
+    return true;
+}
+
+bool frameCacheWriter::writePlane(const cv::Mat &im, uint64_t &offset){
+    offset = cursor;
+    const size_t rowBytes = im.cols*im.elemSize();
+    for(int r=0; r<im.rows; r++){
+        if(fwrite(im.ptr(r), 1, rowBytes, fp)!=rowBytes){
+            return false;
+        }
+    }
+    cursor += rowBytes*im.rows;
+    return padToPage();
+}
+
+bool frameCacheWriter::append(const cv::Mat &imL, const cv::Mat &imR){
+    if(!fp || !imL.data || !imR.data){
+        return false;
+    }
+    frameCacheEntry e;
+    const cv::Mat *views[2] = {&imL, &imR};
+    for(int v=0; v<2; v++){
+        e.rows[v] = views[v]->rows;
+        e.cols[v] = views[v]->cols;
+        e.type[v] = views[v]->type();
+        if(!writePlane(*views[v], e.offset[v])){
+            cerr<<"Frame cache write failed at frame "<<index.size()<<endl;
+            return false;
+        }
+    }
+    index.emplace_back(e);
+    return true;
+}
+
+bool frameCacheWriter::close(){
+    if(!fp){
+        return false;
+    }
+    bool ok = true;
+    header.nFrames = index.size();
+    header.indexOffset = cursor;
+    if(!index.empty()){
+        ok &= fwrite(index.data(), sizeof(frameCacheEntry), index.size(), fp)==index.size();
+    }
+    ok &= fseek(fp, 0, SEEK_SET)==0;
+    ok &= fwrite(&header, sizeof(header), 1, fp)==1;
+    fclose(fp);
+    fp = NULL;
+    return ok;
+}
+
+
+frameCacheReader::~frameCacheReader(){
+    close();
+}
+
+bool frameCacheReader::open(const string &path){
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd<0){
+        cerr<<"Could not open frame cache "<<path<<endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st)!=0 || (size_t)st.st_size<sizeof(frameCacheHeader)){
+        ::close(fd);
+        return false;
+    }
+    mappedBytes = st.st_size;
+    void *ptr = mmap(NULL, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(ptr==MAP_FAILED){
+        cerr<<"mmap failed on "<<path<<endl;
+        mappedBytes = 0;
+        return false;
+    }
+    base = (unsigned char*)ptr;
+    memcpy(&header, base, sizeof(header));
+
+    if(memcmp(header.magic, FRAME_CACHE_MAGIC, 8)!=0 || header.version!=FRAME_CACHE_VERSION ||
+       header.indexOffset + header.nFrames*sizeof(frameCacheEntry) > mappedBytes){
+        cerr<<path<<" is not a valid frame cache"<<endl;
+        close();
+        return false;
+    }
+    index = (const frameCacheEntry*)(base + header.indexOffset);
+    madvise(base, mappedBytes, MADV_SEQUENTIAL);
+    return true;
+}
+
+void frameCacheReader::close(){
+    if(base){
+        munmap(base, mappedBytes);
+    }
+    base = NULL;
+    index = NULL;
+    mappedBytes = 0;
+}
+
+uint64_t frameCacheReader::planeBytes(const frameCacheEntry &e, int v) const{
+    if(e.rows[v]<=0 || e.cols[v]<=0 || e.type[v]<0 || e.type[v]>=CV_DEPTH_MAX*CV_CN_MAX){
+        return 0;
+    }
+    const uint64_t len = (uint64_t)e.rows[v]*e.cols[v]*CV_ELEM_SIZE(e.type[v]);
+    // written so neither side can overflow
+    if(e.offset[v]>mappedBytes || len>mappedBytes - e.offset[v]){
+        return 0;
+    }
+    return len;
+}
+
+bool frameCacheReader::getFrame(int idx, stereoFrame &frame) const{
+    if(!base || idx<0 || idx>=(int)header.nFrames){
+        return false;
+    }
+    const frameCacheEntry &e = index[idx];
+    if(!planeBytes(e, 0) || !planeBytes(e, 1)){
+        cerr<<"Frame cache entry "<<idx<<" points past the end of the file"<<endl;
+        return false;
+    }
+    frame.idx = idx;
+    frame.imL = cv::Mat(e.rows[0], e.cols[0], e.type[0], base + e.offset[0]);
+    frame.imR = cv::Mat(e.rows[1], e.cols[1], e.type[1], base + e.offset[1]);
+    return true;
+}
+
+void frameCacheReader::prefetch(int idx) const{
+    if(!base || idx<0 || idx>=(int)header.nFrames){
+        return;
+    }
+    const frameCacheEntry &e = index[idx];
+    const uint64_t lenR = planeBytes(e, 1);
+    if(!planeBytes(e, 0) || !lenR || e.offset[1]<e.offset[0]){
+        return;
+    }
+    const uint64_t endR = e.offset[1] + lenR;
+    madvise(base + e.offset[0], endR - e.offset[0], MADV_WILLNEED);
+}
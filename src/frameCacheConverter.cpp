@@ -0,0 +1,97 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <opencv2/core.hpp>
+#include "opencv2/highgui/highgui.hpp"
+
+#include "../include/frameCache.h"
+#include "../include/datasetSource.h"
+
+using namespace std;
+using namespace cv;
+
+static void printUsage(const char *name){
+    cerr<<"usage : "<<name<<" <left pattern> <right pattern> <out.fcache> [max frames] [--calib calib.txt] [--gray]"<<endl;
+    cerr<<"   eg : "<<name<<" .../00/image_2/%0.6d.png .../00/image_3/%0.6d.png seq00.fcache --calib .../00/calib.txt"<<endl;
+    cerr<<"--calib stores P2/P3 of a KITTI calib.txt (P0/P1 with --gray), without it the cache has no calibration"<<endl;
+}
+
+// printf style pattern with the frame number filled in, any length
+static string frameName(const char *pattern, int idx){
+    const int n = snprintf(NULL, 0, pattern, idx);
+    if(n<0){
+        return "";
+    }
+    vector<char> buf(n + 1);
+    snprintf(buf.data(), buf.size(), pattern, idx);
+    return string(buf.data(), n);
+}
+
+// one time conversion of a printf style PNG sequence into a packed replay file
+int main(int argc, char **argv){
+    if(argc<4){
+        printUsage(argv[0]);
+        return 1;
+    }
+    const char* lFptr = argv[1];
+    const char* rFptr = argv[2];
+    int maxFrames = -1;
+    string calibFile;
+    bool gray = false;
+    for(int i=4; i<argc; i++){
+        const string a = argv[i];
+        if(a=="--calib" && i+1<argc) calibFile = argv[++i];
+        else if(a=="--gray") gray = true;
+        else if(a.compare(0, 2, "--")!=0) maxFrames = atoi(argv[i]);
+        else{
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // the replay trusts what is stored here, so nothing rather than a guess
+    stereoCalibration calib;
+    if(!calibFile.empty() && !calib.readKitti(calibFile, gray)){
+        cerr<<"No "<<(gray ? "P0/P1" : "P2/P3")<<" in "<<calibFile<<endl;
+        return 1;
+    }
+    if(!calib.valid()){
+        cerr<<"No calibration given, visualSLAM will fall back to its defaults on this cache"<<endl;
+    }
+
+    frameCacheWriter writer;
+    if(!writer.open(argv[3])){
+        return 1;
+    }
+    writer.setCalibration(calib.fx, calib.fy, calib.cx, calib.cy, calib.baseline);
+
+    int iter = 0;
+    for(; maxFrames<0 || iter<maxFrames; iter++){
+        Mat imL = imread(frameName(lFptr, iter));
+        Mat imR = imread(frameName(rFptr, iter));
+        if(!imL.data || !imR.data){
+            break;
+        }
+        if(!writer.append(imL, imR)){
+            return 1;
+        }
+        if(iter%100==0){
+            cerr<<"Packed frame "<<iter<<endl;
+        }
+    }
+    if(!writer.close()){
+        cerr<<"Failed to finalize "<<argv[3]<<endl;
+        return 1;
+    }
+    cerr<<"Wrote "<<iter<<" frames to "<<argv[3]<<endl;
+    return 0;
+}
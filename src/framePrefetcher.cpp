@@ -0,0 +1,64 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/framePrefetcher.h"
+
+framePrefetcher::framePrefetcher(frameLoader loader, int lookahead, int nThreads)
+    : load(loader), lookahead(lookahead), decodePool(nThreads){
+    if(this->lookahead<1){
+        this->lookahead = 1;
+    }
+}
+
+void framePrefetcher::start(int firstIdx, int endIdx){
+    nextIdx = firstIdx;
+    this->endIdx = endIdx;
+    schedule(firstIdx);
+}
+
+void framePrefetcher::schedule(int idx){
+    if(nextIdx<idx){
+        nextIdx = idx;
+    }
+    while(nextIdx<idx+lookahead && (endIdx<0 || nextIdx<endIdx)){
+        pendingFrame p;
+        p.frame = std::make_shared<stereoFrame>();
+        p.frame->idx = nextIdx;
+
+        std::shared_ptr<stereoFrame> slot = p.frame;
+        frameLoader loader = load;
+        int i = nextIdx;
+        p.ready = decodePool.enqueue([slot, loader, i](){
+            return loader(i, *slot);
+        });
+        pending[nextIdx] = std::move(p);
+        nextIdx++;
+    }
+}
+
+bool framePrefetcher::getFrame(int idx, stereoFrame &frame){
+    // everything before idx is never going to be asked for again
+    while(!pending.empty() && pending.begin()->first<idx){
+        pending.erase(pending.begin());
+    }
+
+    auto it = pending.find(idx);
+    if(it==pending.end()){
+        // random access outside the window, decode on the caller
+        frame = stereoFrame();
+        frame.idx = idx;
+        bool ok = load(idx, frame);
+        schedule(idx+1);
+        return ok;
+    }
+
+    bool ok = it->second.ready.get();
+    frame = *(it->second.frame);
+    pending.erase(it);
+
+    schedule(idx+1);
+    return ok;
+}
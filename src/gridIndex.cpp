@@ -0,0 +1,118 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/gridIndex.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+inline int gridIndex::cellOf(float v) const{
+    return (int)std::floor(v*invCell);
+}
+
+inline uint32_t gridIndex::bucketOf(int cx, int cy) const{
+    // the usual large prime spatial hash, cells far apart rarely share a bucket
+    return (((uint32_t)cx*73856093u) ^ ((uint32_t)cy*19349663u)) & tableMask;
+}
+
+void gridIndex::clear(){
+    src = nullptr;
+    order.clear();
+    start.clear();
+    keys.clear();
+    tableMask = 0;
+}
+
+void gridIndex::build(const vector<Point2f> &pts){
+    buildFrom(pts, nullptr, pts.size());
+}
+
+void gridIndex::build(const vector<Point2f> &pts, const vector<int> &subset){
+    buildFrom(pts, subset.data(), subset.size());
+}
+
+void gridIndex::buildFrom(const vector<Point2f> &pts, const int *subset, size_t n){
+    src = &pts;
+    invCell = 1.0f/std::max(cell, 1e-3f);
+
+    // about two buckets per point keeps the chains short
+    uint32_t buckets = 16;
+    while(buckets<2*n){
+        buckets <<= 1;
+    }
+    tableMask = buckets - 1;
+
+    // counting sort by bucket
+    keys.resize(n);
+    start.assign(buckets + 1, 0);
+    for(size_t k=0; k<n; k++){
+        const Point2f &p = pts[subset ? subset[k] : k];
+        keys[k] = bucketOf(cellOf(p.x), cellOf(p.y));
+        start[keys[k] + 1]++;
+    }
+    for(uint32_t b=0; b<buckets; b++){
+        start[b+1] += start[b];
+    }
+    order.resize(n);
+    for(size_t k=0; k<n; k++){
+        order[start[keys[k]]++] = subset ? subset[k] : (int)k;
+    }
+    // the fill pass moved every start one bucket ahead, shift back
+    for(uint32_t b=buckets; b>0; b--){
+        start[b] = start[b-1];
+    }
+    start[0] = 0;
+}
+
+bool gridIndex::anyWithin(const Point2f &p, float radius) const{
+    if(order.empty()){
+        return false;
+    }
+    const vector<Point2f> &pts = *src;
+    const float r2 = radius*radius;
+    const int span = std::max(1, (int)std::ceil(radius*invCell));
+    const int cx = cellOf(p.x), cy = cellOf(p.y);
+    for(int y=cy-span; y<=cy+span; y++){
+        for(int x=cx-span; x<=cx+span; x++){
+            const uint32_t b = bucketOf(x, y);
+            for(int k=start[b]; k<start[b+1]; k++){
+                const Point2f d = pts[order[k]] - p;
+                if(d.x*d.x + d.y*d.y < r2){
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void gridIndex::radiusQuery(const Point2f &p, float radius, vector<int> &out) const{
+    out.clear();
+    if(order.empty()){
+        return;
+    }
+    const vector<Point2f> &pts = *src;
+    const float r2 = radius*radius;
+    const int span = std::max(1, (int)std::ceil(radius*invCell));
+    const int cx = cellOf(p.x), cy = cellOf(p.y);
+    for(int y=cy-span; y<=cy+span; y++){
+        for(int x=cx-span; x<=cx+span; x++){
+            const uint32_t b = bucketOf(x, y);
+            for(int k=start[b]; k<start[b+1]; k++){
+                const Point2f &q = pts[order[k]];
+                const Point2f d = q - p;
+                // two of the visited cells can share a bucket, only report a
+                // point from its own cell so it comes out once
+                if(d.x*d.x + d.y*d.y < r2 && cellOf(q.x)==x && cellOf(q.y)==y){
+                    out.push_back(order[k]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+
+#include <opencv2/core.hpp>
+
+#include "../include/gridIndex.h"
+
+using namespace std;
+using namespace cv;
+
+// the removeDuplicates loop monoUtils.h used to have, kept here as reference
+static vector<int> legacyRemoveDuplicates(vector<Point2f>&base, vector<Point2f>&fresh, vector<int>&mask, int radius){
+    vector<int> res;
+    for(int i=0; i<fresh.size(); i++){
+        Point2f&p2 = fresh[i];
+        bool inRange=false;
+        for(auto j:mask){
+            Point2f&p1 = base[j];
+            if(norm(p1-p2)<radius){
+                inRange=true;
+                break;
+            }
+        }
+        if(!inRange){res.push_back(i);}
+    }
+    return res;
+}
+
+static vector<int> gridRemoveDuplicates(vector<Point2f>&base, vector<Point2f>&fresh, vector<int>&mask, int radius){
+    vector<int> res;
+    gridIndex index((float)radius);
+    index.build(base, mask);
+    for(int i=0; i<fresh.size(); i++){
+        if(!index.anyWithin(fresh[i], (float)radius)){
+            res.push_back(i);
+        }
+    }
+    return res;
+}
+
+static void scatter(std::mt19937 &rng, int n, vector<Point2f> &out){
+    std::uniform_real_distribution<float> ux(0.0f, 1241.0f), uy(0.0f, 376.0f);
+    out.resize(n);
+    for(int i=0; i<n; i++){
+        out[i] = Point2f(ux(rng), uy(rng));
+    }
+}
+
+// existing tracks vs the same number of fresh candidates on a KITTI sized
+// frame, every base point masked in, radius 10 as in the tracker
+int main(int argc, char **argv){
+    const int radius = argc>1 ? atoi(argv[1]) : 10;
+    const int sizes[] = {2000, 10000, 50000};
+    std::mt19937 rng(42);
+
+    cout<<"points\tlegacy ms\tgrid ms\tspeedup\tkept\tmatch"<<endl;
+    for(int n : sizes){
+        vector<Point2f> base, fresh;
+        scatter(rng, n, base);
+        scatter(rng, n, fresh);
+        vector<int> mask(n);
+        for(int i=0; i<n; i++){
+            mask[i] = i;
+        }
+
+        auto t0 = chrono::high_resolution_clock::now();
+        vector<int> a = legacyRemoveDuplicates(base, fresh, mask, radius);
+        auto t1 = chrono::high_resolution_clock::now();
+        vector<int> b = gridRemoveDuplicates(base, fresh, mask, radius);
+        auto t2 = chrono::high_resolution_clock::now();
+
+        double msLegacy = chrono::duration<double, std::milli>(t1-t0).count();
+        double msGrid = chrono::duration<double, std::milli>(t2-t1).count();
+        cout<<n<<"\t"<<msLegacy<<"\t"<<msGrid<<"\t"<<msLegacy/msGrid<<"x\t"<<b.size()
+            <<"\t"<<(a==b ? "yes" : "NO")<<endl;
+    }
+    return 0;
+}
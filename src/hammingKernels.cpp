@@ -0,0 +1,152 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/hammingKernels.h"
+
+// x86 kernels are compiled per function and picked at load time from what
+// the cpu reports, so a portable build still gets them
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAMMING_X86_DISPATCH
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx2,avx512f,avx512vpopcntdq")))
+#include <immintrin.h>
+
+enum hammingPath{ HAMMING_SCALAR, HAMMING_AVX2, HAMMING_AVX512 };
+
+static hammingPath pickPath(){
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")){
+        return HAMMING_AVX512;
+    }
+    return __builtin_cpu_supports("avx2") ? HAMMING_AVX2 : HAMMING_SCALAR;
+}
+static const hammingPath path = pickPath();
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#ifdef HAMMING_X86_DISPATCH
+// per byte popcount through a nibble lookup, summed into the four 64 bit
+// lanes by sad against zero
+AVX2_TARGET static inline __m256i popcountLanes(__m256i x){
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(x, low4);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low4);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+// both return how many candidates they handled, the scalar loop does the rest.
+// gcc flags the _mm512_undefined placeholders in its own headers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+AVX512_TARGET __attribute__((noinline)) static int hammingAVX512(const packedDescriptor &q, const packedDescriptor *cands, int n, int *dist){
+    int i = 0;
+    // two candidates per register, lanes 0-3 are the first one
+    const __m512i qq = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i*)q.data()));
+    for(; i+4<=n; i+=4){
+        __m512i p0 = _mm512_popcnt_epi64(_mm512_xor_si512(qq, _mm512_loadu_si512((const void*)(cands + i))));
+        __m512i p1 = _mm512_popcnt_epi64(_mm512_xor_si512(qq, _mm512_loadu_si512((const void*)(cands + i + 2))));
+        // candidates i+2/i+3 go in the high halves of the words, then each
+        // group of four lanes is folded into its first lane
+        __m512i s = _mm512_or_si512(p0, _mm512_slli_epi64(p1, 32));
+        s = _mm512_add_epi64(s, _mm512_permutex_epi64(s, _MM_SHUFFLE(2,3,0,1)));
+        s = _mm512_add_epi64(s, _mm512_permutex_epi64(s, _MM_SHUFFLE(1,0,3,2)));
+        const uint64_t a = _mm_cvtsi128_si64(_mm512_castsi512_si128(s));
+        const uint64_t b = _mm_cvtsi128_si64(_mm256_castsi256_si128(_mm512_extracti64x4_epi64(s, 1)));
+        dist[i]   = (int)(a & 0xffffffff);
+        dist[i+1] = (int)(b & 0xffffffff);
+        dist[i+2] = (int)(a >> 32);
+        dist[i+3] = (int)(b >> 32);
+    }
+    return i;
+}
+#pragma GCC diagnostic pop
+
+AVX2_TARGET static int hammingAVX2(const packedDescriptor &q, const packedDescriptor *cands, int n, int *dist){
+    int i = 0;
+    const __m256i qv = _mm256_loadu_si256((const __m256i*)q.data());
+    for(; i+4<=n; i+=4){
+        __m256i s0 = popcountLanes(_mm256_xor_si256(qv, _mm256_loadu_si256((const __m256i*)(cands + i))));
+        __m256i s1 = popcountLanes(_mm256_xor_si256(qv, _mm256_loadu_si256((const __m256i*)(cands + i + 1))));
+        __m256i s2 = popcountLanes(_mm256_xor_si256(qv, _mm256_loadu_si256((const __m256i*)(cands + i + 2))));
+        __m256i s3 = popcountLanes(_mm256_xor_si256(qv, _mm256_loadu_si256((const __m256i*)(cands + i + 3))));
+        // lanes are at most 64, pack the four candidates into 16 bit fields
+        // and do a single horizontal sum
+        __m256i s = _mm256_or_si256(_mm256_or_si256(s0, _mm256_slli_epi64(s1, 16)),
+                                    _mm256_or_si256(_mm256_slli_epi64(s2, 32), _mm256_slli_epi64(s3, 48)));
+        __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+        const uint64_t r = (uint64_t)_mm_cvtsi128_si64(h) + (uint64_t)_mm_extract_epi64(h, 1);
+        dist[i]   = (int)(r & 0xffff);
+        dist[i+1] = (int)((r >> 16) & 0xffff);
+        dist[i+2] = (int)((r >> 32) & 0xffff);
+        dist[i+3] = (int)(r >> 48);
+    }
+    return i;
+}
+#endif
+
+void hammingDistances(const packedDescriptor &q, const packedDescriptor *cands, int n, int *dist){
+    int i = 0;
+#if defined(HAMMING_X86_DISPATCH)
+    if(path==HAMMING_AVX512){
+        i = hammingAVX512(q, cands, n, dist);
+    }
+    else if(path==HAMMING_AVX2){
+        i = hammingAVX2(q, cands, n, dist);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t q0 = vld1q_u8((const uint8_t*)q.data());
+    const uint8x16_t q1 = vld1q_u8((const uint8_t*)q.data() + 16);
+    for(; i<n; i++){
+        const uint8_t *c = (const uint8_t*)cands[i].data();
+        uint8x16_t cnt = vaddq_u8(vcntq_u8(veorq_u8(q0, vld1q_u8(c))), vcntq_u8(veorq_u8(q1, vld1q_u8(c + 16))));
+        dist[i] = vaddlvq_u8(cnt);
+    }
+#endif
+    for(; i<n; i++){
+        dist[i] = hammingDistance(q, cands[i]);
+    }
+}
+
+int nearestHamming(const packedDescriptor &q, const packedDescriptor *cands, int n, int *bestDist){
+    int dist[16];
+    int best = 0, bestD = 257;
+    for(int start=0; start<n; start+=16){
+        const int m = n - start < 16 ? n - start : 16;
+        hammingDistances(q, cands + start, m, dist);
+        for(int j=0; j<m; j++){
+            if(dist[j]<bestD){
+                bestD = dist[j];
+                best = start + j;
+            }
+        }
+    }
+    if(bestDist){
+        *bestDist = bestD;
+    }
+    return best;
+}
+
+const char* hammingKernelISA(){
+#if defined(HAMMING_X86_DISPATCH)
+    if(path==HAMMING_AVX512){
+        return "AVX-512 VPOPCNTQ";
+    }
+    if(path==HAMMING_AVX2){
+        return "AVX2";
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return "NEON";
+#endif
+#if defined(__POPCNT__)
+    return "POPCNT";
+#else
+    return "scalar";
+#endif
+}
@@ -6,28 +6,134 @@ PART OF ROS STERO SLAM, UNDER MIT LICENSE.
 
 #include "../include/visualSLAM.h"
 
-void visualSLAM::insertKeyFrames(int start, Mat imL, Mat imR, Mat&pose4dTransform, vector<Point2f>&ftrPts, vector<Point3f>&ref3dCoords){
-    vector<Point2f> new2d;
-    vector<Point3f> new3d;
-    
-    ftrPts.clear();
-    ref3dCoords.clear();
+// tops the tracked set up from this frame (or rebuilds it when keepTracks is
+// off). camPts gets the points this keyframe added in the camera frame, the
+// table keeps them in the world frame
+void visualSLAM::insertKeyFrames(int start, stereoFrame&frame, Mat&pose4dTransform, landmarkTable&lm, vector<Point3f>&camPts,
+                                 bool keepTracks){
+    const size_t kept = keepTracks ? lm.size() : 0;
+    stereoTriangulate(frame, lm, keepTracks);
+    lm.recordObservations(frame.idx);
+    camPts.assign(lm.xyz.begin() + kept, lm.xyz.end());
+    mapRgb.assign(lm.rgb.begin() + kept, lm.rgb.end());
 
-    stereoTriangulate(imL, imR, new3d, new2d);
-
-    untransformed = new3d;
-
-    for(int i=0; i<new3d.size(); i++){
-        Point3f pt = new3d[i];
-        Point3f p;
+    for(size_t i=kept; i<lm.size(); i++){
+        const Point3f pt = lm.xyz[i];
+        Point3f &p = lm.xyz[i];
 
         p.x = pose4dTransform.at<double>(0,0)*pt.x + pose4dTransform.at<double>(0,1)*pt.y + pose4dTransform.at<double>(0,2)*pt.z + pose4dTransform.at<double>(0,3);
         p.y = pose4dTransform.at<double>(1,0)*pt.x + pose4dTransform.at<double>(1,1)*pt.y + pose4dTransform.at<double>(1,2)*pt.z + pose4dTransform.at<double>(1,3);
         p.z = pose4dTransform.at<double>(2,0)*pt.x + pose4dTransform.at<double>(2,1)*pt.y + pose4dTransform.at<double>(2,2)*pt.z + pose4dTransform.at<double>(2,3);
+    }
+}
+
+// mapping stage : filters keyframe clouds, grows the render map and the pose
+// graph and records every frame's pose, all off the tracking thread. only
+// keyframes carry points, the per frame record is just the pose. poseHistory,
+// trajectory, keyFrameHistory and the graph belong to this thread,
+// renderMutex only guards what the viewer and the stats line read
+void visualSLAM::mapFrame(mapJob&job){
+    correctJob(job);
+
+    // frames that rode along with this job tracked against the keyframe
+    // before it
+    const size_t nPoses = job.poses.size();
+    for(size_t i=0; i+1<nPoses; i++){
+        recordPose(job.poses[i]);
+    }
+
+    if(job.keyframe){
+        SORcloud(job.cloud, job.rgb);
+        vector<Point3f> world = update3dtransformation(job.cloud, job.pose4dTransform);
+
+        keyFrame kf;
+        kf.idx = job.idx;
+        kf.vertex = stageForPGO(job.idx, job.R, job.t, job.loopMatch, job.loopQuery);
+        kf.R = job.R;
+        kf.t = job.t;
+        kf.ref3dCoords.swap(job.cloud);
+        kf.rgb = job.rgb;
+
+        Eigen::Isometry3d curPose = cvMat2Eigen(job.R, job.t);
+        renderMutex.lock();
+        isoVector.emplace_back(curPose);
+        mapHistory.emplace_back(world);
+        colorHistory.emplace_back(job.rgb);
+        keyFrameHistory.add(kf);
+        mapFirstKf += trimToWindow(mapHistory, renderWindow);
+        trimToWindow(colorHistory, renderWindow);
+        trimToWindow(isoVector, poseWindow);
+        renderVersion++;
+        renderMutex.unlock();
+
+        trajectory.emplace_back(job.t.clone());
+        trimToWindow(trajectory, poseWindow);
+
+        if(job.loopMatch>=0){
+            closeLoop(kf.vertex);
+        }
+    }
+
+    if(nPoses){
+        recordPose(job.poses[nPoses-1]);
+    }
+}
+
+void visualSLAM::recordPose(framePose&fp){
+    fp.keyFrame = (int)keyFrameHistory.size() - 1;
+    poseHistory.emplace_back(fp);
+    trimToWindow(poseHistory, poseWindow);
+}
+
+// the tracker's view of how far the current frame has drifted from the last
+// keyframe, R/t being the camera->world pose of this frame
+keyFrameSignals visualSLAM::gatherKeyFrameSignals(int iter, const Mat&R, const Mat&t, const vector<int>&inliers){
+    keyFrameSignals s;
+    s.frame = iter;
+    s.framesSince = iter - lastKfFrame;
+    s.inliers = (int)inliers.size();
+    s.trackedAtKeyFrame = lastKfTracks;
+    s.elapsed = dataset->timestamp(iter) - dataset->timestamp(lastKfFrame);
+
+    // ids only grow, anything up to lastKfMaxId was around at the keyframe
+    for(size_t i=0; i<landmarks.size(); i++){
+        s.tracked += landmarks.id[i]<=lastKfMaxId;
+    }
+    for(int i : inliers){
+        s.covisible += landmarks.id[i]<=lastKfMaxId;
+    }
 
-        ref3dCoords.emplace_back(p);
-        ftrPts.emplace_back(new2d[i]);
+    parallaxBuf.clear();
+    if(!landmarks.history.empty()){
+        const trackObservations &o = landmarks.history.back();
+        for(size_t k=0; k<o.id.size(); k++){
+            const int slot = landmarks.slotOf(o.id[k]);
+            if(slot>=0){
+                const Point2f d = landmarks.uv[slot] - o.uv[k];
+                parallaxBuf.push_back(std::sqrt(d.x*d.x + d.y*d.y));
+            }
+        }
+    }
+    if(!parallaxBuf.empty()){
+        std::nth_element(parallaxBuf.begin(), parallaxBuf.begin() + parallaxBuf.size()/2, parallaxBuf.end());
+        s.parallax = parallaxBuf[parallaxBuf.size()/2];
     }
+
+    if(!lastKfT.empty()){
+        s.distance = norm(t - lastKfT);
+        Mat dR = lastKfR.t()*R;
+        double c = (trace(dR)[0] - 1.0)*0.5;
+        s.rotation = std::acos(std::max(-1.0, std::min(1.0, c)));
+    }
+    return s;
+}
+
+void visualSLAM::markKeyFrame(int iter, const Mat&R, const Mat&t){
+    lastKfFrame = iter;
+    lastKfR = R.clone();
+    lastKfT = t.clone();
+    lastKfTracks = (int)landmarks.size();
+    lastKfMaxId = landmarks.empty() ? -1 : *std::max_element(landmarks.id.begin(), landmarks.id.end());
 }
 
 vector<Point3f> visualSLAM::update3dtransformation(vector<Point3f>& pt3d, Mat& pose4dTransform){ 
@@ -45,50 +151,179 @@ vector<Point3f> visualSLAM::update3dtransformation(vector<Point3f>& pt3d, Mat& p
     return updateref3dCoords;
 }
 
-Mat visualSLAM::loadImageL(int iter){
-    char FileName[200];
-    sprintf(FileName, lFptr, iter);
+// calibration and sequence length come from the source from here on
+void visualSLAM::setDataset(std::shared_ptr<datasetSource> source){
+    dataset = source;
+    if(!dataset){
+        return;
+    }
+    dataset->lumaRight = GRAY_FLAG;
+    dataset->lazyRight = true;
+    if(dataset->length()>0){
+        expectedFrames = dataset->length();
+    }
+    const stereoCalibration &c = dataset->calib;
+    if(c.valid()){
+        focal_x = c.fx; focal_y = c.fy;
+        cx = c.cx; cy = c.cy;
+        baseline = c.baseline;
+        K = c.K();
+    }
+    cerr<<"Reading "<<dataset->describe()<<", fx "<<focal_x<<" baseline "<<baseline
+        <<(dataset->hasGroundTruth() ? ", with ground truth" : "")<<endl;
+}
+
+bool visualSLAM::decodeStereoPair(int iter, stereoFrame&frame){
+    frame.idx = iter;
+    if(!dataset || !dataset->load(iter, frame)){
+        return false;
+    }
 
-    Mat im = imread(FileName);
-    // cvtColor(im, im, CV_BGR2GRAY);
-    // cvtColor(im, im, CV_GRAY2BGR);
-    if(!im.data){
-        cout<<"yikes, failed to fetch frame, check the paths"<<endl;
+    if(GRAY_FLAG){
+        cvtColor(frame.imL, frame.grayL, CV_BGR2GRAY);
+    }
+    else{
+        frame.grayL = frame.imL;
     }
-    return im;
+
+    // both pyramids act as "prev" at some point (right one in the stereo
+    // consistency check) so they keep their derivatives
+    buildOpticalFlowPyramid(frame.grayL, frame.pyrL, lkWinSize, lkMaxLevel, true);
+    // sources that hand out the right image for free (cache, ROS) get it
+    // prepared here, decoded ones leave it to keyframes
+    if(frame.imR.data){
+        prepareRight(frame);
+    }
+    return true;
 }
-Mat visualSLAM::loadImageR(int iter){
-    char FileName[200];
-    sprintf(FileName, rFptr, iter);
 
-    Mat im = imread(FileName);
-    // cvtColor(im, im, CV_BGR2GRAY);
-    // cvtColor(im, im, CV_GRAY2BGR);
-    if(!im.data){
-        cout<<"yikes, failed to fetch frame, check the paths"<<endl;
+// right luma plane and pyramid, only keyframes triangulate against them
+void visualSLAM::prepareRight(stereoFrame&frame){
+    if(GRAY_FLAG && frame.imR.channels()==3){
+        cvtColor(frame.imR, frame.grayR, CV_BGR2GRAY);
+    }
+    else{
+        frame.grayR = frame.imR;
+    }
+    if(DENSE_FLAG){
+        buildOpticalFlowPyramid(frame.grayR, frame.pyrR, lkWinSize, lkMaxLevel, true);
     }
-    return im;
 }
 
-void visualSLAM::PerspectiveNpointEstimation(Mat&prevImg, Mat&curImg, vector<Point2f>&ref2dPoints, vector<Point3f>&ref3dPoints, 
-                                vector<Point2f>&tracked2dPoints, vector<Point3f>&tracked3dPoints, Mat&rvec, Mat&tvec,vector<int>&inliers){
-    
-    vector<Point2f> trkUntr; vector<Point3f> trk3dUntr;
-    PyrLKtrackFrame2Frame(referenceImg, currentImage, ref2dPoints, ref3dPoints, tracked2dPoints, tracked3dPoints);
+// decodes the right image of a frame the prefetcher only brought in the
+// left half of
+bool visualSLAM::completeStereoPair(stereoFrame&frame){
+    if(frame.grayR.data){
+        return true;
+    }
+    if(!frame.imR.data && (!dataset || !dataset->loadRight(frame.idx, frame))){
+        return false;
+    }
+    prepareRight(frame);
+    return true;
+}
 
-    //cerr<<"Ref 2d "<<ref2dPoints.size()<<" untrans "<<untransformed.size()<<endl;
-    //PyrLKtrackFrame2Frame(referenceImg, currentImage, ref2dPoints, untransformed, trkUntr, trk3dUntr);
-    
-    Mat distCoeffs = Mat::zeros(4,1,CV_64F);
+stereoFrame& visualSLAM::fetchFrame(int iter){
+    if(curFrame.idx!=iter){
+        curFrameOk = prefetcher->getFrame(iter, curFrame);
+    }
+    return curFrame;
+}
 
-    solvePnPRansac(tracked3dPoints, tracked2dPoints, K, distCoeffs, rvec, tvec, false,100, 1.0, 0.99, inliers);
+Mat visualSLAM::loadImageL(int iter){
+    return fetchFrame(iter).imL;
+}
+Mat visualSLAM::loadImageR(int iter){
+    stereoFrame &frame = fetchFrame(iter);
+    completeStereoPair(frame);
+    return frame.imR;
+}
+
+// tracks lm into the current frame (lost points are dropped from it) and
+// solves the world->camera pose from what is left
+void visualSLAM::PerspectiveNpointEstimation(landmarkTable&lm, Mat&rvec, Mat&tvec,vector<int>&inliers){
+    Mat rvecPred, tvecPred;
+    const bool guided = MOTION_FLAG && motion.ready();
+    if(guided){
+        motion.predict(rvecPred, tvecPred);
+    }
+    PyrLKtrackFrame2Frame(referencePyr, currentPyr, lm, rvecPred, tvecPred);
+
+    if(guided && guidedPnP(lm.xyz, lm.uv, rvecPred, tvecPred, inliers)){
+        rvec = rvecPred; tvec = tvecPred;
+        motion.update(rvec, tvec);
+        guidedFrames++;
+        return;
+    }
+    inliers.clear();
+    ransacFrames++;
+
+    ransacPnP(lm.xyz, lm.uv, rvec, tvec, inliers, 1.0, 0.99);
     if(inliers.size()<10){
         cout<<"Low inlier count at "<<inliers.size()<<", trying again with increased reprojection Threshold "<<endl;
         inliers.clear();
-        solvePnPRansac(tracked3dPoints, tracked2dPoints, K, distCoeffs, rvec, tvec, false,100, 8.0, 0.98, inliers);
+        ransacPnP(lm.xyz, lm.uv, rvec, tvec, inliers, 8.0, 0.98);
         if(inliers.size()<10){
             cerr<<"Man, some incredibly shitty tracking out here, gotta exit bruh"<<endl;
             SHUTDOWN_FLAG = true;
         }
     }
+    if(!rvec.empty()){
+        motion.update(rvec, tvec);
+    }
+}
+
+void visualSLAM::ransacPnP(const vector<Point3f>&pts3d, const vector<Point2f>&pts2d, Mat&rvec, Mat&tvec, vector<int>&inliers,
+                           float threshold, double confidence){
+    if(!CUSTOM_PNP_FLAG){
+        Mat distCoeffs = Mat::zeros(4,1,CV_64F);
+        solvePnPRansac(pts3d, pts2d, K, distCoeffs, rvec, tvec, false, 100, threshold, confidence, inliers);
+        return;
+    }
+    pnpEngine.params.reprojThreshold = threshold;
+    pnpEngine.params.confidence = confidence;
+    pnpEngine.solve(pts3d, pts2d, K, rvec, tvec, inliers);
+    pnpHypotheses += pnpEngine.stats.hypotheses;
+    pnpPreRejected += pnpEngine.stats.preRejected;
+}
+
+// short refinement from the predicted pose : only points that already land
+// near their prediction take part, and the refined pose has to explain most
+// of the tracks at the RANSAC threshold or the caller falls back to RANSAC
+bool visualSLAM::guidedPnP(const vector<Point3f>&pts3d, const vector<Point2f>&pts2d, Mat&rvec, Mat&tvec, vector<int>&inliers){
+    inliers.clear();
+    if((int)pts3d.size()<guidedMinInliers){
+        return false;
+    }
+    Mat distCoeffs = Mat::zeros(4,1,CV_64F);
+    vector<Point2f> &proj = pnpProj;
+
+    projectPoints(pts3d, rvec, tvec, K, distCoeffs, proj);
+    pnpGate.resize(pts3d.size());
+    for(size_t i=0; i<pts3d.size(); i++){
+        Point2f d = proj[i] - pts2d[i];
+        pnpGate[i] = d.x*d.x + d.y*d.y < guidedGate*guidedGate;
+    }
+    pnpGated3d.assign(pts3d.begin(), pts3d.end());
+    pnpGated2d.assign(pts2d.begin(), pts2d.end());
+    if((int)compactByMask(pnpGate, pnpGated3d, pnpGated2d)<guidedMinInliers){
+        return false;
+    }
+
+    Mat r = rvec.clone(), t = tvec.clone();
+    solvePnP(pnpGated3d, pnpGated2d, K, distCoeffs, r, t, true, SOLVEPNP_ITERATIVE);
+
+    projectPoints(pts3d, r, t, K, distCoeffs, proj);
+    for(size_t i=0; i<pts3d.size(); i++){
+        Point2f d = proj[i] - pts2d[i];
+        if(d.x*d.x + d.y*d.y < 1.0){
+            inliers.emplace_back(i);
+        }
+    }
+    if((int)inliers.size()<guidedMinInliers || inliers.size()<guidedMinInlierRatio*pts3d.size()){
+        inliers.clear();
+        return false;
+    }
+    rvec = r; tvec = t;
+    return true;
 }
\ No newline at end of file
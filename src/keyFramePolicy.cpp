@@ -0,0 +1,52 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/keyFramePolicy.h"
+
+const char* keyFrameReasonName(keyFrameReason r){
+    switch(r){
+        case KF_FORCED: return "forced";
+        case KF_INLIERS: return "inliers";
+        case KF_SURVIVAL: return "survival";
+        case KF_COVISIBILITY: return "covis";
+        case KF_PARALLAX: return "parallax";
+        case KF_TIME: return "time";
+        case KF_DISTANCE: return "distance";
+        default: return "none";
+    }
+}
+
+keyFrameReason inlierKeyFramePolicy::decide(const keyFrameSignals &s){
+    return s.inliers<minInliers ? KF_INLIERS : KF_NONE;
+}
+
+keyFrameReason multiCueKeyFramePolicy::decide(const keyFrameSignals &s){
+    if(s.inliers<params.minInliers){
+        return KF_INLIERS;
+    }
+    if(s.framesSince<params.minFrames){
+        return KF_NONE;
+    }
+    if(s.trackedAtKeyFrame>0){
+        const float base = (float)s.trackedAtKeyFrame;
+        if(s.tracked<params.minSurvival*base){
+            return KF_SURVIVAL;
+        }
+        if(s.covisible<params.minCovisibility*base){
+            return KF_COVISIBILITY;
+        }
+    }
+    if(s.parallax>params.maxParallax){
+        return KF_PARALLAX;
+    }
+    if(s.elapsed>params.maxElapsed){
+        return KF_TIME;
+    }
+    if(s.distance>params.maxDistance || s.rotation>params.maxRotation){
+        return KF_DISTANCE;
+    }
+    return KF_NONE;
+}
@@ -0,0 +1,128 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/keyFrameStore.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+keyFrameStore::keyFrameStore(size_t budgetBytes, const string &spillPath) : budget(budgetBytes), path(spillPath) {}
+
+keyFrameStore::~keyFrameStore(){
+    if(fp){
+        fclose(fp);
+        remove(path.c_str());
+    }
+}
+
+void keyFrameStore::setBudget(size_t budgetBytes){
+    budget = budgetBytes;
+    enforceBudget();
+}
+
+void keyFrameStore::setSpillPath(const string &spillPath){
+    if(!fp){
+        path = spillPath;
+    }
+}
+
+size_t keyFrameStore::add(keyFrame &kf){
+    entries.emplace_back();
+    entry &e = entries.back();
+    e.kf.idx = kf.idx;
+    e.kf.vertex = kf.vertex;
+    e.kf.R = kf.R;
+    e.kf.t = kf.t;
+    e.kf.ref3dCoords.swap(kf.ref3dCoords);
+    e.kf.rgb.swap(kf.rgb);
+    e.count = (uint32_t)e.kf.ref3dCoords.size();
+    e.rgbCount = (uint32_t)e.kf.rgb.size();
+
+    const size_t k = entries.size() - 1;
+    lru.push_front(k);
+    e.lruPos = lru.begin();
+    inRam += bytes(e);
+    enforceBudget();
+    return k;
+}
+
+const vector<Point3f>& keyFrameStore::cloud(size_t k){
+    entry &e = entries[k];
+    if(!e.resident){
+        e.kf.ref3dCoords.resize(e.count);
+        e.kf.rgb.resize(e.rgbCount);
+        bool ok = fp && fseeko(fp, e.offset, SEEK_SET)==0;
+        ok = ok && fread(e.kf.ref3dCoords.data(), sizeof(Point3f), e.count, fp)==e.count;
+        ok = ok && fread(e.kf.rgb.data(), sizeof(uint32_t), e.rgbCount, fp)==e.rgbCount;
+        if(!ok){
+            cerr<<"keyframe "<<e.kf.idx<<" could not be read back from "<<path<<endl;
+            e.kf.ref3dCoords.clear();
+            e.kf.rgb.clear();
+        }
+        e.resident = true;
+        lru.push_front(k);
+        e.lruPos = lru.begin();
+        inRam += e.kf.ref3dCoords.size()*sizeof(Point3f) + e.kf.rgb.size()*sizeof(uint32_t);
+        faults++;
+    }
+    else{
+        touch(k);
+    }
+    enforceBudget();
+    return e.kf.ref3dCoords;
+}
+
+size_t keyFrameStore::bytes(const entry &e){
+    return e.count*sizeof(Point3f) + e.rgbCount*sizeof(uint32_t);
+}
+
+void keyFrameStore::touch(size_t k){
+    lru.splice(lru.begin(), lru, entries[k].lruPos);
+}
+
+void keyFrameStore::enforceBudget(){
+    // the most recent one always stays, whatever its size
+    while(inRam>budget && lru.size()>1){
+        entry &e = entries[lru.back()];
+        if(!spill(e)){
+            // disk trouble, keep everything rather than lose points
+            return;
+        }
+        inRam -= e.kf.ref3dCoords.size()*sizeof(Point3f) + e.kf.rgb.size()*sizeof(uint32_t);
+        vector<Point3f>().swap(e.kf.ref3dCoords);
+        vector<uint32_t>().swap(e.kf.rgb);
+        e.resident = false;
+        lru.pop_back();
+        evictions++;
+    }
+}
+
+bool keyFrameStore::spill(entry &e){
+    if(e.offset>=0){
+        return true;
+    }
+    if(!fp){
+        fp = fopen(path.c_str(), "w+b");
+        if(!fp){
+            cerr<<"can't open keyframe spill file "<<path<<", keeping clouds in RAM"<<endl;
+            return false;
+        }
+    }
+    if(fseeko(fp, 0, SEEK_END)!=0){
+        return false;
+    }
+    const int64_t at = ftello(fp);
+    if(fwrite(e.kf.ref3dCoords.data(), sizeof(Point3f), e.count, fp)!=e.count ||
+       fwrite(e.kf.rgb.data(), sizeof(uint32_t), e.rgbCount, fp)!=e.rgbCount){
+        cerr<<"keyframe spill write failed, keeping clouds in RAM"<<endl;
+        return false;
+    }
+    e.offset = at;
+    onDisk += bytes(e);
+    return true;
+}
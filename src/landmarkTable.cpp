@@ -0,0 +1,76 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/landmarkTable.h"
+
+using namespace std;
+using namespace cv;
+
+void landmarkTable::reserve(size_t n){
+    xyz.reserve(n); uv.reserve(n); rgb.reserve(n);
+    id.reserve(n); age.reserve(n); nObs.reserve(n);
+    slots.reserve(n);
+}
+
+void landmarkTable::clear(){
+    slots.clear();
+    xyz.clear(); uv.clear(); rgb.clear();
+    id.clear(); age.clear(); nObs.clear();
+}
+
+int landmarkTable::add(const Point3f &p, const Point2f &obs, uint32_t colour){
+    const int newId = nextId++;
+    slots[newId] = (int)id.size();
+    xyz.push_back(p);
+    uv.push_back(obs);
+    rgb.push_back(colour);
+    id.push_back(newId);
+    age.push_back(0);
+    nObs.push_back(1);
+    return newId;
+}
+
+int landmarkTable::slotOf(int pointId) const{
+    auto it = slots.find(pointId);
+    return it==slots.end() ? -1 : it->second;
+}
+
+void landmarkTable::swapRemove(size_t slot){
+    const size_t last = id.size() - 1;
+    slots.erase(id[slot]);
+    if(slot!=last){
+        xyz[slot] = xyz[last];
+        uv[slot] = uv[last];
+        rgb[slot] = rgb[last];
+        id[slot] = id[last];
+        age[slot] = age[last];
+        nObs[slot] = nObs[last];
+        slots[id[slot]] = (int)slot;
+    }
+    xyz.pop_back(); uv.pop_back(); rgb.pop_back();
+    id.pop_back(); age.pop_back(); nObs.pop_back();
+}
+
+void landmarkTable::markTracked(){
+    for(size_t i=0; i<id.size(); i++){
+        age[i]++;
+        nObs[i]++;
+    }
+}
+
+void landmarkTable::recordObservations(int frame){
+    if(historyWindow==0){
+        return;
+    }
+    while(history.size()>=historyWindow){
+        history.pop_front();
+    }
+    history.emplace_back();
+    trackObservations &o = history.back();
+    o.frame = frame;
+    o.id = id;
+    o.uv = uv;
+}
@@ -0,0 +1,101 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/motionModel.h"
+
+#include <algorithm>
+
+#include <opencv2/calib3d.hpp>
+
+using namespace std;
+using namespace cv;
+
+motionModel::motionModel(double decay)
+    : decay(decay){}
+
+bool motionModel::ready() const{
+    return seen>=2;
+}
+
+void motionModel::reset(){
+    seen = 0;
+}
+
+void motionModel::rebase(const Mat &R, const Mat &t){
+    if(seen==0){
+        return;
+    }
+    Mat t64;
+    t.convertTo(t64, CV_64F);
+    lastR = lastR*R.t();
+    lastT = lastT - lastR*t64.reshape(1, 3);
+}
+
+void motionModel::update(const Mat &rvec, const Mat &tvec){
+    Mat R, t;
+    Rodrigues(rvec, R);
+    tvec.convertTo(t, CV_64F);
+    t = t.reshape(1, 3);
+    if(seen>0){
+        Mat dR = R*lastR.t();
+        Rodrigues(dR, velRvec);
+        velT = t - dR*lastT;
+    }
+    lastR = R;
+    lastT = t.clone();
+    seen = std::min(seen+1, 2);
+}
+
+void motionModel::predict(Mat &rvec, Mat &tvec) const{
+    if(seen==0){
+        rvec.release(); tvec.release();
+        return;
+    }
+    if(!ready()){
+        Rodrigues(lastR, rvec);
+        tvec = lastT.clone();
+        return;
+    }
+    // scaling the axis-angle vector scales the rotation angle
+    Mat dR;
+    Rodrigues(velRvec*decay, dR);
+    Mat R = dR*lastR;
+    tvec = dR*lastT + velT*decay;
+    Rodrigues(R, rvec);
+}
+
+void projectWithPose(const vector<Point3f> &pts3d, const Mat &rvec, const Mat &tvec,
+                     const Mat &K, const Size &imSize, const vector<Point2f> &fallback,
+                     vector<Point2f> &proj, vector<uchar> &valid){
+    Mat R;
+    Rodrigues(rvec, R);
+    const double *r = R.ptr<double>(0);
+    Mat t64;
+    tvec.convertTo(t64, CV_64F);
+    const double *t = t64.ptr<double>(0);
+    const double fx = K.at<double>(0,0), fy = K.at<double>(1,1);
+    const double cx = K.at<double>(0,2), cy = K.at<double>(1,2);
+
+    proj.resize(pts3d.size());
+    valid.resize(pts3d.size());
+    for(size_t i=0; i<pts3d.size(); i++){
+        const Point3f &p = pts3d[i];
+        double x = r[0]*p.x + r[1]*p.y + r[2]*p.z + t[0];
+        double y = r[3]*p.x + r[4]*p.y + r[5]*p.z + t[1];
+        double z = r[6]*p.x + r[7]*p.y + r[8]*p.z + t[2];
+        valid[i] = 0;
+        proj[i] = fallback[i];
+        if(z<=1e-3){
+            continue;
+        }
+        float u = (float)(fx*x/z + cx), v = (float)(fy*y/z + cy);
+        if(u<0 || v<0 || u>=imSize.width || v>=imSize.height){
+            continue;
+        }
+        proj[i] = Point2f(u, v);
+        valid[i] = 1;
+    }
+}
@@ -0,0 +1,147 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/ANMS.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+
+void adaptiveNonMaximalSuppresion( std::vector<cv::KeyPoint>& keypoints,
+                                    const int numToKeep )
+{
+    if( (int)keypoints.size() <= numToKeep ) { return; }
+
+    //
+    // Sort by response
+    //
+    std::sort( keypoints.begin(), keypoints.end(),
+                [&]( const cv::KeyPoint& lhs, const cv::KeyPoint& rhs )
+                {
+                return lhs.response > rhs.response;
+                } );
+
+    std::vector<cv::KeyPoint> anmsPts;
+
+    std::vector<double> radii;
+    radii.resize( keypoints.size() );
+    std::vector<double> radiiSorted;
+    radiiSorted.resize( keypoints.size() );
+
+    const float robustCoeff = 1.11; // see paper
+
+    for( int i = 0; i < keypoints.size(); ++i )
+    {
+    const float response = keypoints[i].response * robustCoeff;
+    double radius = std::numeric_limits<double>::max();
+    for( int j = 0; j < i && keypoints[j].response > response; ++j )
+    {
+        radius = std::min( radius, cv::norm( keypoints[i].pt - keypoints[j].pt ) );
+    }
+    radii[i]       = radius;
+    radiiSorted[i] = radius;
+    }
+
+    std::sort( radiiSorted.begin(), radiiSorted.end(),
+                [&]( const double& lhs, const double& rhs )
+                {
+                return lhs > rhs;
+                } );
+
+    const double decisionRadius = radiiSorted[numToKeep];
+    for( int i = 0; i < radii.size(); ++i ){
+        if( radii[i] >= decisionRadius ){
+            anmsPts.push_back( keypoints[i] );
+        }
+    }
+
+    anmsPts.swap( keypoints );
+}
+
+
+void sscNonMaximalSuppression( std::vector<cv::KeyPoint>& keypoints,
+                               const int numToKeep, const int cols, const int rows,
+                               const float tolerance )
+{
+    const int n = keypoints.size();
+    if( n <= numToKeep || numToKeep < 2 ) { return; }
+
+    std::sort( keypoints.begin(), keypoints.end(),
+                [&]( const cv::KeyPoint& lhs, const cv::KeyPoint& rhs )
+                {
+                return lhs.response > rhs.response;
+                } );
+
+    // bounds on the covering square width, closed form from the paper
+    const double K = numToKeep;
+    const double exp1 = rows + cols + 2*K;
+    const double exp2 = 4*cols + 4*K + 4*rows*K + (double)rows*rows + (double)cols*cols
+                        - 2.0*rows*cols + 4.0*rows*cols*K;
+    const double exp3 = std::sqrt( exp2 );
+    const double exp4 = K - 1;
+    const double sol1 = -std::round( (exp1 + exp3) / exp4 );
+    const double sol2 = -std::round( (exp1 - exp3) / exp4 );
+
+    int high = (int)std::max( sol1, sol2 );
+    int low = (int)std::floor( std::sqrt( (double)n / K ) );
+    low = std::max( low, 1 );
+
+    const int Kmin = (int)std::round( K - K*tolerance );
+    const int Kmax = (int)std::round( K + K*tolerance );
+
+    std::vector<int> result, best;
+    std::vector<uchar> covered;
+    int prevWidth = -1;
+
+    while( low <= high )
+    {
+        const int width = low + (high - low) / 2;
+        if( width == prevWidth ) { break; }
+        prevWidth = width;
+
+        const int c = std::max( width / 2, 1 );
+        const int gridCols = cols / c + 1;
+        const int gridRows = rows / c + 1;
+        const int reach = width / c;
+        covered.assign( gridCols * gridRows, 0 );
+        result.clear();
+
+        for( int i = 0; i < n; ++i )
+        {
+            const int row = std::min( gridRows - 1, std::max( 0, (int)( keypoints[i].pt.y / c ) ) );
+            const int col = std::min( gridCols - 1, std::max( 0, (int)( keypoints[i].pt.x / c ) ) );
+            if( covered[row * gridCols + col] ) { continue; }
+
+            result.push_back( i );
+            const int r0 = std::max( 0, row - reach ), r1 = std::min( gridRows - 1, row + reach );
+            const int c0 = std::max( 0, col - reach ), c1 = std::min( gridCols - 1, col + reach );
+            for( int r = r0; r <= r1; ++r )
+            {
+                std::fill( covered.begin() + r * gridCols + c0, covered.begin() + r * gridCols + c1 + 1, 1 );
+            }
+        }
+
+        // remember the closest attempt in case the search never lands in range
+        if( best.empty() || std::abs( (int)result.size() - numToKeep ) < std::abs( (int)best.size() - numToKeep ) )
+        {
+            best = result;
+        }
+
+        if( (int)result.size() >= Kmin && (int)result.size() <= Kmax ) { break; }
+        if( (int)result.size() < Kmin ) { high = width - 1; }
+        else                            { low = width + 1; }
+    }
+
+    // the search only lands within tolerance of the budget and may miss it
+    // entirely, the points are in response order so cut the weakest
+    if( (int)best.size() > numToKeep ) { best.resize( numToKeep ); }
+
+    std::vector<cv::KeyPoint> anmsPts;
+    anmsPts.reserve( best.size() );
+    for( int i : best ) { anmsPts.push_back( keypoints[i] ); }
+    anmsPts.swap( keypoints );
+}
@@ -1,36 +1,158 @@
 #include "../include/visualSLAM.h"
 
-void visualSLAM::stageForPGO(Mat Rl, Mat tl, Mat Rg, Mat tg, bool loopClose){
-    Eigen::Isometry3d localT, globalT;
-    localT = cvMat2Eigen(Rl, tl);
-    globalT = cvMat2Eigen(Rg, tg);
-    if(loopClose){
-        LC_FLAG = true;
-        poseGraph.addLoopClosure(globalT,LCidx);
+// mapping thread : adds a keyframe's vertex, and the closing edge when the
+// keyframe closes a loop. returns the new vertex
+int visualSLAM::stageForPGO(int frame, const Mat&R, const Mat&t, int loopMatch, int loopQuery){
+    Eigen::Isometry3d globalT = cvMat2Eigen(R, t);
+    poseGraph.augmentNode(globalT, globalT);
+    vertexFrames.push_back(frame);
+    if(loopMatch>=0){
+        poseGraph.addLoopClosure(globalT, vertexOf(loopMatch), vertexOf(loopQuery));
     }
-    else{
-        poseGraph.augmentNode(localT, globalT);
-    } 
+    return (int)vertexFrames.size() - 1;
+}
+
+// mapping thread, right after the closing keyframe went in : optimises the
+// graph, re-places the map and tells the tracker how the world moved
+void visualSLAM::closeLoop(int vertex){
+    const Eigen::Isometry3d before = poseGraph.vertices[vertex]->estimate();
+    vector<Eigen::Isometry3d> trans = poseGraph.globalOptimize();
+
+    renderMutex.lock();
+    isoVector = trans;
+    trimToWindow(isoVector, poseWindow);
+    updateOdometry(trans);
+    renderVersion++;
+    renderMutex.unlock();
+
+    postCorrection(trans[vertex]*before.inverse());
+}
+
+// a correction that finds the queue full is folded into the next one, the
+// tracker never sees half of a move
+void visualSLAM::postCorrection(const Eigen::Isometry3d&C){
+    unpostedCorrection = C*unpostedCorrection;
+    correctionPending = true;
+    Eigen::Isometry3d T = unpostedCorrection;
+    if(worldCorrections.tryPush(std::move(T))){
+        postedCorrections.push_back(unpostedCorrection);
+        unpostedCorrection = Eigen::Isometry3d::Identity();
+        correctionPending = false;
+    }
+}
+
+static void correctPose(const Eigen::Isometry3d&C, Mat&R, Mat&t){
+    Eigen::Isometry3d T = C*cvMat2Eigen(R, t);
+    R = Mat(3,3,CV_64F);
+    for(int i=0; i<3; i++){
+        for(int j=0; j<3; j++){
+            R.at<double>(i,j) = T(i,j);
+        }
+    }
+    t = Eigen2cvMat(T).t();
+}
+
+// mapping thread : brings a job made before the tracker saw the latest
+// corrections into the graph's world
+void visualSLAM::correctJob(mapJob&job){
+    if(correctionPending){
+        postCorrection(Eigen::Isometry3d::Identity());
+    }
+    // jobs come in order, nothing older than this one will need these again
+    while(correctionBase<job.epoch && !postedCorrections.empty()){
+        postedCorrections.pop_front();
+        correctionBase++;
+    }
+    if(postedCorrections.empty() && !correctionPending){
+        return;
+    }
+    Eigen::Isometry3d C = Eigen::Isometry3d::Identity();
+    for(const Eigen::Isometry3d &p : postedCorrections){
+        C = p*C;
+    }
+    C = unpostedCorrection*C;
+
+    if(job.keyframe){
+        correctPose(C, job.R, job.t);
+        // the tracker's copy of the transform is shared, build a new one
+        job.pose4dTransform = Mat(3,4,CV_64F);
+        for(int c=0; c<3; c++){
+            job.R.col(c).copyTo(job.pose4dTransform.col(c));
+        }
+        job.t.copyTo(job.pose4dTransform.col(3));
+    }
+    for(framePose &fp : job.poses){
+        correctPose(C, fp.R, fp.t);
+    }
+}
+
+// tracker : moves everything it tracks against into the corrected world
+void visualSLAM::applyWorldCorrection(const Eigen::Isometry3d&C){
+    for(Point3f &p : landmarks.xyz){
+        Eigen::Vector3d q = C*Eigen::Vector3d(p.x, p.y, p.z);
+        p = Point3f((float)q.x(), (float)q.y(), (float)q.z());
+    }
+    if(!lastKfT.empty()){
+        correctPose(C, lastKfR, lastKfT);
+    }
+    // these ride on a later job, its epoch will already include C
+    for(framePose &fp : poseBacklog){
+        correctPose(C, fp.R, fp.t);
+    }
+    if(!lastT.empty()){
+        Eigen::Vector3d c = C*Eigen::Vector3d(lastT.at<double>(0), lastT.at<double>(1), lastT.at<double>(2));
+        lastT = (Mat_<double>(3,1) << c.x(), c.y(), c.z());
+    }
+    Mat R(3,3,CV_64F), t(3,1,CV_64F);
+    for(int i=0; i<3; i++){
+        for(int j=0; j<3; j++){
+            R.at<double>(i,j) = C(i,j);
+        }
+        t.at<double>(i) = C(i,3);
+    }
+    motion.rebase(R, t);
 }
 
+// the graph only has keyframes, a frame maps to the last keyframe at or
+// before it
+int visualSLAM::vertexOf(int frame) const{
+    auto it = std::upper_bound(vertexFrames.begin(), vertexFrames.end(), frame);
+    return it==vertexFrames.begin() ? 0 : (int)(it - vertexFrames.begin()) - 1;
+}
 
 void visualSLAM::updateOdometry(vector<Eigen::Isometry3d>&T){
     cerr<<"\n\nUpdating global odometry measurements..."<<endl;
     trajectory.clear();
-    trajectory.reserve(T.size());
-    for(Eigen::Isometry3d &isoMatrix : T){
-        Mat t = Eigen2cvMat(isoMatrix);
+    const size_t first = T.size()>poseWindow ? T.size()-poseWindow : 0;
+    trajectory.reserve(T.size()-first);
+    for(size_t i=first; i<T.size(); i++){
+        Mat t = Eigen2cvMat(T[i]);
         trajectory.emplace_back(t.clone());
     }
+    // every keyframe takes its optimised pose, rotation included, so the
+    // map lands in the same world the tracker was corrected into. poses are
+    // always in RAM
+    for(size_t j=0; j<keyFrameHistory.size(); j++){
+        keyFrame &kf = keyFrameHistory.meta(j);
+        // a keyframe the graph hasn't seen yet keeps its tracked pose, it
+        // still needs its slot so colorHistory lines up
+        if(kf.vertex>=0 && kf.vertex<(int)T.size()){
+            const Eigen::Matrix3d r = T[kf.vertex].rotation();
+            kf.R = Mat(3,3,CV_64F);
+            for(int a=0; a<3; a++){
+                for(int b=0; b<3; b++){
+                    kf.R.at<double>(a,b) = r(a,b);
+                }
+            }
+            kf.t = Eigen2cvMat(T[kf.vertex]).t();
+        }
+    }
     cerr<<"Updating global 3D map..."<<endl;
+    // only the render window is rebuilt, spilled clouds in it are read back
     mapHistory.clear();
-    for(size_t j=0; j<keyFrameHistory.size(); j++){
-        keyFrame kf = keyFrameHistory[j];
-        Mat R,t;
-        t = trajectory[j];
-        R = kf.R;
-        kf.t = t;
-        t = t.t();
+    for(size_t j=mapFirstKf; j<keyFrameHistory.size(); j++){
+        keyFrame &kf = keyFrameHistory.meta(j);
+        Mat R = kf.R, t = kf.t;
 
         Mat pose4dTransform = Mat::zeros(3,4, CV_64F);
         R.col(0).copyTo(pose4dTransform.col(0));
@@ -38,28 +160,73 @@ void visualSLAM::updateOdometry(vector<Eigen::Isometry3d>&T){
         R.col(2).copyTo(pose4dTransform.col(2));
         t.copyTo(pose4dTransform.col(3));
         
-        vector<Point3f> updatePts = update3dtransformation(kf.ref3dCoords, pose4dTransform);
-        if(kf.retrack){
-            mapHistory.emplace_back(updatePts);
-        }
+        vector<Point3f> cam = keyFrameHistory.cloud(j);
+        mapHistory.emplace_back(update3dtransformation(cam, pose4dTransform));
     }
     cerr<<"DONE; Trajectory size : "<<trajectory.size()<<" KeyFrame size : "<<keyFrameHistory.size()<<endl;
 }
 
+// runs on the loop stage thread, candidates are posted back to the tracker.
+// jobs can be dropped on the way in, so everything is counted in frames
 void visualSLAM::checkLoopDetectorStatus(Mat img, int idx){
-    Ptr<FeatureDetector> orb = ORB::create();
     vector<KeyPoint> kp;
     Mat desc;
     vector<FORB::TDescriptor> descriptors;
 
-    orb->detectAndCompute(img, Mat(), kp, desc);
+    featureService->extractLoopFeatures(img, kp, desc);
     restructure(desc, descriptors);
+
+    // quantized once, the gate and the detector share it
+    BowVector bow;
+    FeatureVector feat;
+    const OrbLoopDetector::Parameters &lp = loopDetector->getParameters();
+    if(lp.geom_check==GEOM_DI){
+        voc->transform(descriptors, bow, feat, lp.di_levels);
+    }
+    else{
+        voc->transform(descriptors, bow);
+    }
+
+    // frames that look just like the last entry add nothing to recall, only
+    // to the size of the inverted index
+    if(loopGateScore>0){
+        if(!lastLoopBow.empty() && voc->score(bow, lastLoopBow)>loopGateScore){
+            loopGated++;
+            return;
+        }
+        lastLoopBow = bow;
+    }
+
     DetectionResult result;
-    loopDetector->detectLoop(kp, descriptors, result);
-    if(result.detection() &&(result.query-result.match > 100) && cooldownTimer==0){
-        cerr<<"Found Loop Closure between "<<idx<<" and "<<result.match<<endl;
-        LC_FLAG = true;
-        LCidx = result.match-1;
-        cooldownTimer = 100;
+    loopDetector->detectLoop(kp, descriptors, bow, feat, result);
+    // a full database was thinned first, its entries were renumbered
+    if(loopDetector->getThinnings()!=loopThinnings){
+        loopThinnings = loopDetector->getThinnings();
+        const vector<EntryId> &kept = loopDetector->getKeptEntries();
+        for(size_t j=0; j<kept.size(); j++){
+            loopEntryFrames[j] = loopEntryFrames[kept[j]];
+        }
+        loopEntryFrames.resize(kept.size());
+    }
+    // every call adds exactly one database entry
+    loopEntryFrames.push_back(idx);
+    loopDbSize = (long)loopEntryFrames.size();
+    if(!result.detection()){
+        return;
+    }
+    const int match = loopEntryFrames[result.match];
+    if(idx-match > loopMinGap && idx-lastLoopFrame > loopCooldown){
+        cerr<<"Found Loop Closure between "<<idx<<" and "<<match<<endl;
+        // precision check against ground truth where there is some
+        Matx34d gq, gm;
+        if(dataset->groundTruthPose(idx, gq) && dataset->groundTruthPose(match, gm)){
+            const double dx = gq(0,3) - gm(0,3), dy = gq(1,3) - gm(1,3), dz = gq(2,3) - gm(2,3);
+            (std::sqrt(dx*dx + dy*dy + dz*dz)<loopGtRadius ? loopGtTrue : loopGtFalse)++;
+        }
+        loopCandidate lc;
+        lc.query = idx;
+        lc.match = match;
+        loopResults.tryPush(std::move(lc));
+        lastLoopFrame = idx;
     }
 }
\ No newline at end of file
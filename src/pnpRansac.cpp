@@ -0,0 +1,173 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/pnpRansac.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/calib3d.hpp>
+
+using namespace std;
+using namespace cv;
+
+static void poseToFloat(const Mat &rvec, const Mat &tvec, float *R, float *t){
+    Mat Rm;
+    Rodrigues(rvec, Rm);
+    for(int i=0; i<9; i++){
+        R[i] = (float)Rm.at<double>(i/3, i%3);
+    }
+    for(int i=0; i<3; i++){
+        t[i] = (float)tvec.at<double>(i);
+    }
+}
+
+pnpRansac::pnpRansac(const pnpRansacParams &params)
+    : params(params), rng(0x5eed){}
+
+// full set score, gives up (returns -1) once the points left can't lift the
+// count past best
+int pnpRansac::score(const rectifiedRig &cam, const float *R, const float *t, int best, unsigned char *m){
+    const int n = (int)u.size();
+    const float thr2 = params.reprojThreshold*params.reprojThreshold;
+    const int block = std::max(8, params.scoreBlock);
+    int count = 0;
+    for(int s=0; s<n; s+=block){
+        const int len = std::min(block, n - s);
+        count += reprojectionInliers(cam, R, t, X.x.data()+s, X.y.data()+s, X.z.data()+s,
+                                     u.data()+s, v.data()+s, len, thr2, m ? m+s : 0);
+        if(!m && count + (n - s - len) <= best){
+            return -1;
+        }
+    }
+    return count;
+}
+
+bool pnpRansac::solve(const vector<Point3f> &pts3d, const vector<Point2f> &pts2d,
+                      const Mat &K, Mat &rvec, Mat &tvec, vector<int> &inliers){
+    stats = pnpRansacStats();
+    inliers.clear();
+    const int n = (int)pts3d.size();
+    const int sampleSize = 4;
+    if(n<sampleSize || (int)pts2d.size()!=n){
+        return false;
+    }
+
+    X.resize(n); u.resize(n); v.resize(n); mask.resize(n);
+    for(int i=0; i<n; i++){
+        X.x[i] = pts3d[i].x; X.y[i] = pts3d[i].y; X.z[i] = pts3d[i].z;
+        u[i] = pts2d[i].x; v[i] = pts2d[i].y;
+    }
+    rectifiedRig cam;
+    cam.fx = (float)K.at<double>(0,0); cam.fy = (float)K.at<double>(1,1);
+    cam.cx = (float)K.at<double>(0,2); cam.cy = (float)K.at<double>(1,2);
+    cam.baseline = 0;
+
+    const Mat distCoeffs = Mat::zeros(4,1,CV_64F);
+    const float thr2 = params.reprojThreshold*params.reprojThreshold;
+    const int d = std::max(0, params.preTestPoints);
+    const double logFail = std::log(1.0 - params.confidence);
+
+    int best = 0;
+    Mat bestR, bestT;
+    int budget = params.maxIterations;
+    sample3d.resize(sampleSize); sample2d.resize(sampleSize);
+
+    for(int it=0; it<budget; it++){
+        stats.hypotheses++;
+        int idx[sampleSize];
+        for(int k=0; k<sampleSize; k++){
+            bool repeat = true;
+            while(repeat){
+                idx[k] = rng.uniform(0, n);
+                repeat = false;
+                for(int j=0; j<k; j++){
+                    repeat |= idx[j]==idx[k];
+                }
+            }
+            sample3d[k] = pts3d[idx[k]];
+            sample2d[k] = pts2d[idx[k]];
+        }
+
+        Mat r, t;
+        if(!solvePnP(sample3d, sample2d, K, distCoeffs, r, t, false, SOLVEPNP_P3P)){
+            stats.minimalFailures++;
+            continue;
+        }
+        float Rf[9], tf[3];
+        poseToFloat(r, t, Rf, tf);
+
+        bool pass = true;
+        for(int k=0; k<d && pass; k++){
+            int j = rng.uniform(0, n);
+            pass = reprojectionInliers(cam, Rf, tf, &X.x[j], &X.y[j], &X.z[j], &u[j], &v[j], 1, thr2, 0)==1;
+        }
+        if(!pass){
+            stats.preRejected++;
+            continue;
+        }
+
+        int count = score(cam, Rf, tf, best, 0);
+        if(count<0){
+            stats.bailedOut++;
+            continue;
+        }
+        stats.fullyScored++;
+        if(count>best){
+            best = count;
+            bestR = r; bestT = t;
+            // a good hypothesis has to get the sample and the pre-test right
+            const double w = (double)best/n;
+            const double pGood = std::pow(w, sampleSize + d);
+            if(pGood>=1.0){
+                budget = it + 1;
+            }
+            else if(pGood>0){
+                double need = logFail/std::log(1.0 - pGood);
+                budget = (int)std::min<double>(params.maxIterations, std::ceil(need));
+            }
+        }
+    }
+    stats.iterationBudget = budget;
+
+    if(best<sampleSize){
+        return false;
+    }
+
+    float Rf[9], tf[3];
+    poseToFloat(bestR, bestT, Rf, tf);
+    score(cam, Rf, tf, -1, mask.data());
+
+    if(params.refine){
+        refine3d.clear(); refine2d.clear();
+        for(int i=0; i<n; i++){
+            if(mask[i]){
+                refine3d.emplace_back(pts3d[i]);
+                refine2d.emplace_back(pts2d[i]);
+            }
+        }
+        // solvePnP's iterative mode is Levenberg-Marquardt from the guess
+        Mat r = bestR.clone(), t = bestT.clone();
+        solvePnP(refine3d, refine2d, K, distCoeffs, r, t, true, SOLVEPNP_ITERATIVE);
+        poseToFloat(r, t, Rf, tf);
+        if(score(cam, Rf, tf, -1, 0)>=best){
+            bestR = r; bestT = t;
+            score(cam, Rf, tf, -1, mask.data());
+        }
+    }
+
+    for(int i=0; i<n; i++){
+        if(mask[i]){
+            inliers.emplace_back(i);
+        }
+    }
+    stats.inliers = (int)inliers.size();
+    bestR.convertTo(rvec, CV_64F);
+    bestT.convertTo(tvec, CV_64F);
+    rvec = rvec.reshape(1, 3);
+    tvec = tvec.reshape(1, 3);
+    return true;
+}
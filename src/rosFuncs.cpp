@@ -6,7 +6,7 @@ PART OF ROS STERO SLAM, UNDER MIT LICENSE.
 
 #include "../include/visualSLAM.h"
 
-void visualSLAM::SORcloud(vector<Point3f>&ref3d, vector<Point3f>&colorMap){
+void visualSLAM::SORcloud(vector<Point3f>&ref3d, vector<uint32_t>&colorMap){
     cloudType::Ptr bufferCloud (new cloudType);
     for(size_t i=0; i<ref3d.size(); i+=1){
         if(-1*ref3d[i].z>500){
@@ -14,7 +14,7 @@ void visualSLAM::SORcloud(vector<Point3f>&ref3d, vector<Point3f>&colorMap){
         }
         pcl::PointXYZRGB clPt;
         clPt.x = ref3d[i].x; clPt.y = ref3d[i].y; clPt.z = ref3d[i].z;
-        clPt.r = colorMap[i].z; clPt.g = colorMap[i].y; clPt.b = colorMap[i].x;
+        clPt.r = redOf(colorMap[i]); clPt.g = greenOf(colorMap[i]); clPt.b = blueOf(colorMap[i]);
         bufferCloud->points.emplace_back(clPt);
     }
     pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor;
@@ -25,57 +25,80 @@ void visualSLAM::SORcloud(vector<Point3f>&ref3d, vector<Point3f>&colorMap){
 
     ref3d.clear(); colorMap.clear();
     for(size_t i=0; i<bufferCloud->points.size(); i++){
-        pcl::PointXYZRGB cldPt;
-        Point3f p3d, c3d;
-
-        cldPt = bufferCloud->points[i];
+        const pcl::PointXYZRGB &cldPt = bufferCloud->points[i];
+        ref3d.emplace_back(cldPt.x, cldPt.y, cldPt.z);
+        colorMap.emplace_back(packRGB(cldPt.r, cldPt.g, cldPt.b));
+    }
+}
 
-        p3d.x = cldPt.x; p3d.y = cldPt.y; p3d.z = cldPt.z;
-        c3d.x = cldPt.b; c3d.y = cldPt.g; c3d.z = cldPt.r;
+void visualSLAM::rosPublish(vector<vector<Point3f>>&pt3d, Mat&trajROS, Mat&Rmat){
+    publishCloud(pt3d, colorHistory);
+    publishPose(trajROS, Rmat, true);
+}
 
-        ref3d.emplace_back(p3d);
-        colorMap.emplace_back(c3d);
+// world points into the rviz frame the map is published in
+static void appendCloud(cloudType &msg, const vector<Point3f>&ref3dCoords, const vector<uint32_t>&colorMap){
+    double mulFactor = 0.1;
+    for(size_t i=0; i<ref3dCoords.size(); i+=1){
+        if(-1*ref3dCoords[i].z>500){
+            continue;
+        }
+        pcl::PointXYZRGB clPt;
+        clPt.x = ref3dCoords[i].x * mulFactor; clPt.y = ref3dCoords[i].z *mulFactor; clPt.z = -1*ref3dCoords[i].y*mulFactor;
+        if(i<colorMap.size()){
+            clPt.r = redOf(colorMap[i]); clPt.g = greenOf(colorMap[i]); clPt.b = blueOf(colorMap[i]);
+        }
+        msg.points.emplace_back(clPt);
     }
 }
 
-void visualSLAM::rosPublish(vector<vector<Point3f>>&pt3d, Mat&trajROS, Mat&Rmat){
-    //cerr<<"Publishing messages"<<endl;
+void visualSLAM::publishCloud(const vector<vector<Point3f>>&pt3d, const vector<vector<uint32_t>>&colors){
     cloudType::Ptr msg (new cloudType);
-    geometry_msgs::PoseStamped poseMsg;
     msg->header.frame_id = "map";
-    double mulFactor = 0.1;
 
-    int siz = 0;
     for(size_t k=0; k<pt3d.size(); k++){
-        vector<Point3f> ref3dCoords = pt3d[k];
-        vector<Point3f> colorMap = colorHistory[k];
-        for(size_t i=0; i<ref3dCoords.size(); i+=1){
-            if(-1*ref3dCoords[i].z>500){
-                continue;
-            }
-            pcl::PointXYZRGB clPt;
-            siz+=1;
-            clPt.x = ref3dCoords[i].x * mulFactor; clPt.y = ref3dCoords[i].z *mulFactor; clPt.z = -1*ref3dCoords[i].y*mulFactor;
-            clPt.r = colorMap[i].z; clPt.g = colorMap[i].y; clPt.b = colorMap[i].x;
-            msg->points.emplace_back(clPt);
-            }
-        }
-    if(SHUTDOWN_FLAG){
-        cerr<<"SAVING POINTCLOUD as "<<plySavepath<<endl;
-        pcl::io::savePLYFileBinary(plySavepath, *msg);
-        cerr<<"DONE"<<endl;
+        appendCloud(*msg, pt3d[k], colors[k]);
     }
     mapPublisher.publish(msg);
+}
+
+// the saved map covers every keyframe of the run, not just the render
+// window. spilled clouds are read back one keyframe at a time and placed at
+// their keyframe's (optimised) pose
+void visualSLAM::exportMap(){
+    cloudType::Ptr msg (new cloudType);
+    msg->header.frame_id = "map";
+    vector<Point3f> world;
+    for(size_t j=0; j<keyFrameHistory.size(); j++){
+        const vector<Point3f> &cam = keyFrameHistory.cloud(j);
+        const keyFrame &kf = keyFrameHistory.meta(j);
+        const Matx33d R = kf.R;
+        const Vec3d t(kf.t.at<double>(0), kf.t.at<double>(1), kf.t.at<double>(2));
+        world.resize(cam.size());
+        for(size_t i=0; i<cam.size(); i++){
+            const Vec3d p = R*Vec3d(cam[i].x, cam[i].y, cam[i].z) + t;
+            world[i] = Point3f((float)p[0], (float)p[1], (float)p[2]);
+        }
+        appendCloud(*msg, world, kf.rgb);
+    }
+    cerr<<"SAVING POINTCLOUD as "<<plySavepath<<" ("<<keyFrameHistory.size()<<" keyframes, "<<msg->points.size()<<" points)"<<endl;
+    pcl::io::savePLYFileBinary(plySavepath, *msg);
+    cerr<<"DONE"<<endl;
+}
 
+// the pose always goes out, the path only when toPath is set
+void visualSLAM::publishPose(const Mat&trajROS, const Mat&Rmat, bool toPath){
+    geometry_msgs::PoseStamped poseMsg;
+    double mulFactor = 0.1;
     double Xpos, Ypos, Zpos;
-    trajROS*=mulFactor;
 
-    Xpos = trajROS.at<double>(0);
-    Zpos = trajROS.at<double>(1)*-1;
-    Ypos = trajROS.at<double>(2);
+    Xpos = trajROS.at<double>(0)*mulFactor;
+    Zpos = trajROS.at<double>(1)*mulFactor*-1;
+    Ypos = trajROS.at<double>(2)*mulFactor;
     
     Eigen::Quaterniond q;
-    Rmat2Quat(Rmat, q);
+    Mat R = Rmat;
+    Rmat2Quat(R, q);
     Eigen::Vector4d Qvector = q.coeffs();
 
     //cerr<<"Quat : "<<Qvector<<endl;
@@ -91,8 +114,53 @@ void visualSLAM::rosPublish(vector<vector<Point3f>>&pt3d, Mat&trajROS, Mat&Rmat)
     poseMsg.pose.orientation.w = Qvector[3];
 
     posePublisher.publish(poseMsg);
+    if(!toPath){
+        return;
+    }
     
     trajectoryMsg.header.frame_id = "map";
     trajectoryMsg.poses.emplace_back(poseMsg);
+    trimToWindow(trajectoryMsg.poses, poseWindow);
     trajectoryPublisher.publish(trajectoryMsg);
 }
+
+// publishing stage : debug overlay for the main thread to show, then ROS
+void visualSLAM::publishFrame(publishJob&job){
+    vector<Point3f> dr3d = update3dtransformation(job.pts3d, job.invTransform);
+    Mat drawn = drawDepthCMap(job.gray, dr3d, job.pts2d, job.prevPts2d);
+
+    Mat imCpy, reSizOG;
+    resize(drawn, imCpy, Size(), 0.7, 0.7);
+    resize(job.color, reSizOG, Size(), 0.7, 0.7);
+
+    viewMutex.lock();
+    debugView = imCpy;
+    frameView = reSizOG;
+    viewMutex.unlock();
+
+    if(!PUBLISH_FLAG){
+        return;
+    }
+    const bool toPath = job.idx - lastPathFrame >= pathEvery;
+    if(toPath){
+        lastPathFrame = job.idx;
+    }
+    publishPose(job.t, job.R, toPath);
+
+    // the cloud only changes with keyframes and loop closures. it is copied
+    // under the lock and built outside it, mapping and the viewer never
+    // wait on PCL
+    vector<vector<Point3f>> pts;
+    vector<vector<uint32_t>> colors;
+    renderMutex.lock();
+    const bool moved = renderVersion!=publishedVersion;
+    if(moved){
+        pts = mapHistory;
+        colors = colorHistory;
+        publishedVersion = renderVersion;
+    }
+    renderMutex.unlock();
+    if(moved){
+        publishCloud(pts, colors);
+    }
+}
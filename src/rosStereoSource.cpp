@@ -0,0 +1,136 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/rosStereoSource.h"
+
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+
+using namespace std;
+using namespace cv;
+
+rosStereoSource::rosStereoSource(const string &leftTopic, const string &rightTopic,
+                                 const string &leftInfo, const string &rightInfo, size_t maxBuffered)
+    : left(leftTopic), right(rightTopic), maxBuffered(maxBuffered){
+    nh.setCallbackQueue(&queue);
+
+    if(!leftInfo.empty() && !rightInfo.empty()){
+        infoL = nh.subscribe<sensor_msgs::CameraInfo>(leftInfo, 1, boost::bind(&rosStereoSource::onInfo, this, _1, true));
+        infoR = nh.subscribe<sensor_msgs::CameraInfo>(rightInfo, 1, boost::bind(&rosStereoSource::onInfo, this, _1, false));
+    }
+
+    subL.subscribe(nh, left, 10);
+    subR.subscribe(nh, right, 10);
+    sync.reset(new message_filters::Synchronizer<syncPolicy>(syncPolicy(10), subL, subR));
+    sync->registerCallback(boost::bind(&rosStereoSource::onPair, this, _1, _2));
+
+    spinner.reset(new ros::AsyncSpinner(1, &queue));
+    spinner->start();
+
+    if(infoL){
+        ros::WallTime until = ros::WallTime::now() + ros::WallDuration(5.0);
+        bool found = false;
+        while(ros::ok() && ros::WallTime::now()<until){
+            {
+                lock_guard<mutex> lk(m);
+                if(calib.valid()){
+                    found = true;
+                    break;
+                }
+            }
+            ros::WallDuration(0.05).sleep();
+        }
+        // calib is read without the lock once we return, so no late
+        // camera_info may touch it after this
+        {
+            lock_guard<mutex> lk(m);
+            infoClosed = true;
+            found = calib.valid();
+        }
+        infoL.shutdown();
+        infoR.shutdown();
+        if(!found){
+            cerr<<"No camera_info on "<<leftInfo<<" / "<<rightInfo<<", keeping the default calibration"<<endl;
+        }
+    }
+}
+
+rosStereoSource::~rosStereoSource(){
+    spinner->stop();
+    arrived.notify_all();
+}
+
+void rosStereoSource::onInfo(const sensor_msgs::CameraInfoConstPtr &info, bool isLeft){
+    lock_guard<mutex> lk(m);
+    if(infoClosed){
+        return;
+    }
+    double *P = isLeft ? PL : PR;
+    for(int j=0; j<12; j++){
+        P[j] = info->P[j];
+    }
+    (isLeft ? haveL : haveR) = true;
+    if(haveL && haveR && PL[0]>0){
+        calib.fx = PL[0]; calib.cx = PL[2];
+        calib.fy = PL[5]; calib.cy = PL[6];
+        calib.baseline = (PL[3] - PR[3])/PL[0];
+    }
+}
+
+void rosStereoSource::onPair(const sensor_msgs::ImageConstPtr &l, const sensor_msgs::ImageConstPtr &r){
+    stereoFrame f;
+    try{
+        f.imL = cv_bridge::toCvCopy(l, l->encoding==sensor_msgs::image_encodings::MONO8 ? "mono8" : "bgr8")->image;
+        f.imR = cv_bridge::toCvCopy(r, (lumaRight || r->encoding==sensor_msgs::image_encodings::MONO8) ? "mono8" : "bgr8")->image;
+    }
+    catch(cv_bridge::Exception &e){
+        cerr<<"cv_bridge : "<<e.what()<<endl;
+        return;
+    }
+
+    lock_guard<mutex> lk(m);
+    // the tracker fell behind, drop the pair rather than buffer forever
+    if(frames.size()>=maxBuffered){
+        return;
+    }
+    const double t = l->header.stamp.toSec();
+    if(firstStamp<0){
+        firstStamp = t;
+    }
+    f.idx = received;
+    stamps[received] = t - firstStamp;
+    frames[received] = std::move(f);
+    received++;
+    arrived.notify_all();
+}
+
+bool rosStereoSource::load(int idx, stereoFrame &frame){
+    unique_lock<mutex> lk(m);
+    while(ros::ok() && frames.find(idx)==frames.end()){
+        // handed out already
+        if(idx<received){
+            return false;
+        }
+        arrived.wait_for(lk, std::chrono::milliseconds(100));
+    }
+    auto it = frames.find(idx);
+    if(it==frames.end()){
+        return false;
+    }
+    frame = std::move(it->second);
+    frames.erase(it);
+    // keep a few stamps back for the keyframe policy
+    while(!stamps.empty() && stamps.begin()->first<idx-1000){
+        stamps.erase(stamps.begin());
+    }
+    return frame.imL.data && frame.imR.data;
+}
+
+double rosStereoSource::timestamp(int idx) const{
+    lock_guard<mutex> lk(m);
+    auto it = stamps.find(idx);
+    return it==stamps.end() ? datasetSource::timestamp(idx) : it->second;
+}
@@ -0,0 +1,203 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/stereoKernels.h"
+
+// x86 builds stay portable : the AVX2 paths are compiled per function and
+// picked at load time from what the cpu reports, not from -march
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STEREO_AVX2_DISPATCH
+#define AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+static const bool useAVX2 = __builtin_cpu_supports("avx2");
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// with d = uL-uR :  Z = fx*b/d,  X = (uL-cx)*b/d,  Y = (vL-cy)*(fx/fy)*b/d
+static inline void triangulateScalar(const rectifiedRig &rig, const float *ptsL, const float *ptsR,
+                                     int start, int n, float *X, float *Y, float *Z){
+    const float aspect = rig.fx/rig.fy;
+    for(int i=start; i<n; i++){
+        const float uL = ptsL[2*i], vL = ptsL[2*i+1];
+        const float uR = ptsR[2*i];
+        const float s = rig.baseline/(uL - uR);
+        X[i] = (uL - rig.cx)*s;
+        Y[i] = (vL - rig.cy)*aspect*s;
+        Z[i] = rig.fx*s;
+    }
+}
+
+#ifdef STEREO_AVX2_DISPATCH
+// returns how many points it handled, the scalar loop does the rest
+AVX2_TARGET static int triangulateAVX2(const rectifiedRig &rig, const float *ptsL, const float *ptsR,
+                                       int n, float *X, float *Y, float *Z){
+    int i = 0;
+    const __m256 b = _mm256_set1_ps(rig.baseline);
+    const __m256 fx = _mm256_set1_ps(rig.fx);
+    const __m256 cx = _mm256_set1_ps(rig.cx);
+    const __m256 cy = _mm256_set1_ps(rig.cy);
+    const __m256 aspect = _mm256_set1_ps(rig.fx/rig.fy);
+    for(; i+8<=n; i+=8){
+        // 8 interleaved (u,v) pairs -> one register of u's and one of v's
+        __m256 l0 = _mm256_loadu_ps(ptsL + 2*i);
+        __m256 l1 = _mm256_loadu_ps(ptsL + 2*i + 8);
+        __m256 r0 = _mm256_loadu_ps(ptsR + 2*i);
+        __m256 r1 = _mm256_loadu_ps(ptsR + 2*i + 8);
+
+        __m256 uL = _mm256_shuffle_ps(l0, l1, _MM_SHUFFLE(2,0,2,0));
+        __m256 vL = _mm256_shuffle_ps(l0, l1, _MM_SHUFFLE(3,1,3,1));
+        __m256 uR = _mm256_shuffle_ps(r0, r1, _MM_SHUFFLE(2,0,2,0));
+        uL = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(uL), _MM_SHUFFLE(3,1,2,0)));
+        vL = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(vL), _MM_SHUFFLE(3,1,2,0)));
+        uR = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(uR), _MM_SHUFFLE(3,1,2,0)));
+
+        __m256 s = _mm256_div_ps(b, _mm256_sub_ps(uL, uR));
+        _mm256_storeu_ps(X + i, _mm256_mul_ps(_mm256_sub_ps(uL, cx), s));
+        _mm256_storeu_ps(Y + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(vL, cy), aspect), s));
+        _mm256_storeu_ps(Z + i, _mm256_mul_ps(fx, s));
+    }
+    return i;
+}
+#endif
+
+void triangulateRectified(const rectifiedRig &rig, const float *ptsL, const float *ptsR,
+                          int n, float *X, float *Y, float *Z){
+    int i = 0;
+#if defined(STEREO_AVX2_DISPATCH)
+    if(useAVX2){
+        i = triangulateAVX2(rig, ptsL, ptsR, n, X, Y, Z);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t b = vdupq_n_f32(rig.baseline);
+    const float32x4_t fx = vdupq_n_f32(rig.fx);
+    const float32x4_t cx = vdupq_n_f32(rig.cx);
+    const float32x4_t cy = vdupq_n_f32(rig.cy);
+    const float32x4_t aspect = vdupq_n_f32(rig.fx/rig.fy);
+    for(; i+4<=n; i+=4){
+        float32x4x2_t l = vld2q_f32(ptsL + 2*i);
+        float32x4x2_t r = vld2q_f32(ptsR + 2*i);
+
+        float32x4_t s = vdivq_f32(b, vsubq_f32(l.val[0], r.val[0]));
+        vst1q_f32(X + i, vmulq_f32(vsubq_f32(l.val[0], cx), s));
+        vst1q_f32(Y + i, vmulq_f32(vmulq_f32(vsubq_f32(l.val[1], cy), aspect), s));
+        vst1q_f32(Z + i, vmulq_f32(fx, s));
+    }
+#endif
+    triangulateScalar(rig, ptsL, ptsR, i, n, X, Y, Z);
+}
+
+void triangulateRectified(const rectifiedRig &rig, const float *ptsL, const float *ptsR,
+                          int n, soaPoints3f &out){
+    out.resize(n);
+    triangulateRectified(rig, ptsL, ptsR, n, out.x.data(), out.y.data(), out.z.data());
+}
+
+static inline int reprojectScalar(const rectifiedRig &cam, const float *R, const float *t,
+                                  const float *X, const float *Y, const float *Z,
+                                  const float *u, const float *v, int start, int n, float thr2, unsigned char *mask){
+    int count = 0;
+    for(int i=start; i<n; i++){
+        const float xc = R[0]*X[i] + R[1]*Y[i] + R[2]*Z[i] + t[0];
+        const float yc = R[3]*X[i] + R[4]*Y[i] + R[5]*Z[i] + t[1];
+        const float zc = R[6]*X[i] + R[7]*Y[i] + R[8]*Z[i] + t[2];
+        const float inv = 1.0f/zc;
+        const float du = cam.fx*xc*inv + cam.cx - u[i];
+        const float dv = cam.fy*yc*inv + cam.cy - v[i];
+        const bool in = zc>1e-3f && du*du + dv*dv < thr2;
+        if(mask){
+            mask[i] = in;
+        }
+        count += in;
+    }
+    return count;
+}
+
+#ifdef STEREO_AVX2_DISPATCH
+// inlier count goes to count, returns how many points it handled
+AVX2_TARGET static int reprojectAVX2(const rectifiedRig &cam, const float *R, const float *t,
+                                     const float *X, const float *Y, const float *Z,
+                                     const float *u, const float *v, int n, float thr2,
+                                     unsigned char *mask, int &count){
+    int i = 0;
+    __m256 r[9];
+    for(int k=0; k<9; k++){
+        r[k] = _mm256_set1_ps(R[k]);
+    }
+    const __m256 t0 = _mm256_set1_ps(t[0]), t1 = _mm256_set1_ps(t[1]), t2 = _mm256_set1_ps(t[2]);
+    const __m256 fx = _mm256_set1_ps(cam.fx), fy = _mm256_set1_ps(cam.fy);
+    const __m256 cx = _mm256_set1_ps(cam.cx), cy = _mm256_set1_ps(cam.cy);
+    const __m256 thr = _mm256_set1_ps(thr2), zMin = _mm256_set1_ps(1e-3f);
+    for(; i+8<=n; i+=8){
+        __m256 x = _mm256_loadu_ps(X + i), y = _mm256_loadu_ps(Y + i), z = _mm256_loadu_ps(Z + i);
+        __m256 xc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], x), _mm256_mul_ps(r[1], y)),
+                                  _mm256_add_ps(_mm256_mul_ps(r[2], z), t0));
+        __m256 yc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[3], x), _mm256_mul_ps(r[4], y)),
+                                  _mm256_add_ps(_mm256_mul_ps(r[5], z), t1));
+        __m256 zc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[6], x), _mm256_mul_ps(r[7], y)),
+                                  _mm256_add_ps(_mm256_mul_ps(r[8], z), t2));
+        __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), zc);
+        __m256 du = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(fx, xc), inv), cx), _mm256_loadu_ps(u + i));
+        __m256 dv = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(fy, yc), inv), cy), _mm256_loadu_ps(v + i));
+        __m256 e = _mm256_add_ps(_mm256_mul_ps(du, du), _mm256_mul_ps(dv, dv));
+        __m256 in = _mm256_and_ps(_mm256_cmp_ps(e, thr, _CMP_LT_OQ), _mm256_cmp_ps(zc, zMin, _CMP_GT_OQ));
+        int bits = _mm256_movemask_ps(in);
+        count += __builtin_popcount(bits);
+        if(mask){
+            for(int k=0; k<8; k++){
+                mask[i+k] = (bits>>k) & 1;
+            }
+        }
+    }
+    return i;
+}
+#endif
+
+int reprojectionInliers(const rectifiedRig &cam, const float *R, const float *t,
+                        const float *X, const float *Y, const float *Z,
+                        const float *u, const float *v, int n, float thr2, unsigned char *mask){
+    int i = 0, count = 0;
+#if defined(STEREO_AVX2_DISPATCH)
+    if(useAVX2){
+        i = reprojectAVX2(cam, R, t, X, Y, Z, u, v, n, thr2, mask, count);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t fx = vdupq_n_f32(cam.fx), fy = vdupq_n_f32(cam.fy);
+    const float32x4_t cx = vdupq_n_f32(cam.cx), cy = vdupq_n_f32(cam.cy);
+    const float32x4_t thr = vdupq_n_f32(thr2), zMin = vdupq_n_f32(1e-3f);
+    for(; i+4<=n; i+=4){
+        float32x4_t x = vld1q_f32(X + i), y = vld1q_f32(Y + i), z = vld1q_f32(Z + i);
+        float32x4_t xc = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[0]), x, R[0]), y, R[1]), z, R[2]);
+        float32x4_t yc = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[1]), x, R[3]), y, R[4]), z, R[5]);
+        float32x4_t zc = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[2]), x, R[6]), y, R[7]), z, R[8]);
+        float32x4_t inv = vdivq_f32(vdupq_n_f32(1.0f), zc);
+        float32x4_t du = vsubq_f32(vmlaq_f32(cx, vmulq_f32(fx, xc), inv), vld1q_f32(u + i));
+        float32x4_t dv = vsubq_f32(vmlaq_f32(cy, vmulq_f32(fy, yc), inv), vld1q_f32(v + i));
+        float32x4_t e = vmlaq_f32(vmulq_f32(du, du), dv, dv);
+        uint32x4_t in = vandq_u32(vcltq_f32(e, thr), vcgtq_f32(zc, zMin));
+        // lanes are all ones or zero, shift down to 0/1
+        uint32x4_t one = vshrq_n_u32(in, 31);
+        count += vaddvq_u32(one);
+        if(mask){
+            mask[i]   = vgetq_lane_u32(one, 0);
+            mask[i+1] = vgetq_lane_u32(one, 1);
+            mask[i+2] = vgetq_lane_u32(one, 2);
+            mask[i+3] = vgetq_lane_u32(one, 3);
+        }
+    }
+#endif
+    return count + reprojectScalar(cam, R, t, X, Y, Z, u, v, i, n, thr2, mask);
+}
+
+const char* stereoKernelISA(){
+#if defined(STEREO_AVX2_DISPATCH)
+    return useAVX2 ? "AVX2" : "scalar";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
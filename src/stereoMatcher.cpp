@@ -0,0 +1,159 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/stereoMatcher.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+stereoMatcher::stereoMatcher(int nThreads, const stereoMatchParams &params)
+    : params(params), pool(nThreads){
+    if(this->params.nStripes<1){
+        this->params.nStripes = 1;
+    }
+    stripes.resize(this->params.nStripes);
+}
+
+// pyramids built with derivatives interleave image and gradient levels
+static int levelStride(const vector<Mat> &pyr){
+    return (pyr.size()>1 && pyr[1].depth()==CV_16S) ? 2 : 1;
+}
+
+static inline float bilinear(const Mat &im, float x, float y){
+    const int x0 = cvFloor(x), y0 = cvFloor(y);
+    const float ax = x - x0, ay = y - y0;
+    const uchar *r0 = im.ptr<uchar>(y0) + x0;
+    const uchar *r1 = im.ptr<uchar>(y0+1) + x0;
+    return (1-ay)*((1-ax)*r0[0] + ax*r0[1]) + ay*((1-ax)*r1[0] + ax*r1[1]);
+}
+
+// room for a bilinear window of half size hw/hh around x,y plus the central
+// difference column on either side
+static inline bool windowInside(const Mat &im, float x, float y, int hw, int hh){
+    return x - hw - 1>=0 && x + hw + 2<im.cols && y - hh>=0 && y + hh + 1<im.rows;
+}
+
+bool stereoMatcher::searchRow(const vector<Mat> &from, const vector<Mat> &to,
+                              const Point2f &p, float &x, stripeBuffer &s) const{
+    const int strideF = levelStride(from), strideT = levelStride(to);
+    const int levels = std::min(params.maxLevel, std::min((int)from.size()/strideF, (int)to.size()/strideT) - 1);
+    const int hw = params.winSize.width/2, hh = params.winSize.height/2;
+    const size_t area = (size_t)(2*hw+1)*(2*hh+1);
+    s.patch.resize(area);
+    s.grad.resize(area);
+
+    for(int lvl=levels; lvl>=0; lvl--){
+        const float scale = 1.0f/(1<<lvl);
+        const Mat &A = from[lvl*strideF], &B = to[lvl*strideT];
+        const float px = p.x*scale, py = p.y*scale;
+        float u = x*scale;
+        // coarse levels the window does not fit in are skipped
+        if(!windowInside(A, px, py, hw, hh)){
+            if(lvl==0){
+                return false;
+            }
+            continue;
+        }
+
+        float H = 0;
+        size_t k = 0;
+        for(int i=-hh; i<=hh; i++){
+            for(int j=-hw; j<=hw; j++, k++){
+                s.patch[k] = bilinear(A, px + j, py + i);
+                s.grad[k] = 0.5f*(bilinear(A, px + j + 1, py + i) - bilinear(A, px + j - 1, py + i));
+                H += s.grad[k]*s.grad[k];
+            }
+        }
+        // no texture along x, the row gives nothing to lock on to
+        if(H<1e-2f*area){
+            if(lvl==0){
+                return false;
+            }
+            continue;
+        }
+
+        // the right window stays on the left point's row, only its x moves
+        for(int it=0; it<params.maxIters; it++){
+            if(!windowInside(B, u, py, hw, hh)){
+                return false;
+            }
+            float b = 0;
+            k = 0;
+            for(int i=-hh; i<=hh; i++){
+                for(int j=-hw; j<=hw; j++, k++){
+                    b += s.grad[k]*(s.patch[k] - bilinear(B, u + j, py + i));
+                }
+            }
+            const float du = b/H;
+            u += du;
+            if(std::fabs(du)<params.epsilon){
+                break;
+            }
+        }
+        x = u/scale;
+    }
+    return true;
+}
+
+void stereoMatcher::matchStripe(const vector<Mat> &pyrL, const vector<Mat> &pyrR, stripeBuffer &s){
+    s.right.clear();
+    size_t n = 0;
+    for(size_t i=0; i<s.left.size(); i++){
+        const Point2f l = s.left[i];
+        float xr = l.x;
+        if(!searchRow(pyrL, pyrR, l, xr, s)){
+            continue;
+        }
+        const float disparity = l.x - xr;
+        if(disparity<params.minDisparity || disparity>params.maxDisparity){
+            continue;
+        }
+        // round trip starts from where the point came from, converges fast
+        float xb = l.x;
+        if(!searchRow(pyrR, pyrL, Point2f(xr, l.y), xb, s) || std::fabs(l.x - xb)>params.lrThreshold){
+            continue;
+        }
+        s.left[n] = l;
+        s.right.emplace_back(xr, l.y);
+        n++;
+    }
+    s.left.resize(n);
+}
+
+void stereoMatcher::match(const vector<Mat> &pyrL, const vector<Mat> &pyrR, int rows,
+                          vector<Point2f> &ptsL, vector<Point2f> &ptsR){
+    const int nStripes = (int)stripes.size();
+    const float stripeHeight = std::max(1.0f, (float)rows/nStripes);
+
+    for(stripeBuffer &s : stripes){
+        s.left.clear();
+    }
+    for(const Point2f &p : ptsL){
+        int k = std::min(nStripes-1, std::max(0, (int)(p.y/stripeHeight)));
+        stripes[k].left.emplace_back(p);
+    }
+
+    vector<std::future<void>> jobs;
+    jobs.reserve(nStripes);
+    for(int k=0; k<nStripes; k++){
+        stripeBuffer *s = &stripes[k];
+        jobs.emplace_back(pool.enqueue([this, &pyrL, &pyrR, s](){
+            matchStripe(pyrL, pyrR, *s);
+        }));
+    }
+    for(std::future<void> &j : jobs){
+        j.get();
+    }
+
+    ptsL.clear(); ptsR.clear();
+    for(stripeBuffer &s : stripes){
+        ptsL.insert(ptsL.end(), s.left.begin(), s.left.end());
+        ptsR.insert(ptsR.end(), s.right.begin(), s.right.end());
+    }
+}
@@ -11,81 +11,69 @@ vector<KeyPoint> visualSLAM::denseKeypointExtractor(Mat img, int stepSize){
     return out;
 }
 
-void visualSLAM::denseLKtracking(Mat refImg, Mat curImg, vector<Point2f>&refPts, vector<Point2f>&trackPts){
-    vector<Point2f> trPts, inlierRefPts, inlierTracked;
-    vector<uchar> Idx;
-    vector<float> err;
-    calcOpticalFlowPyrLK(refImg, curImg, refPts, trPts,Idx, err);
-
-    for(int i=0; i<refPts.size(); i++){
-        if(Idx[i]==1){
-            inlierRefPts.emplace_back(refPts[i]);
-            inlierTracked.emplace_back(trPts[i]);
-        }
-    }
-    trackPts.clear(); refPts.clear();
-    trackPts = inlierTracked; refPts = inlierRefPts;
+void visualSLAM::denseLKtracking(const vector<Mat>&refPyr, const vector<Mat>&curPyr, vector<Point2f>&refPts, vector<Point2f>&trackPts){
+    calcOpticalFlowPyrLK(refPyr, curPyr, refPts, trackPts, lkStatus, lkErr, lkWinSize, lkMaxLevel);
+    compactByMask(lkStatus, refPts, trackPts);
 }
 
 void visualSLAM::FmatThresholding(vector<Point2f>&refPts, vector<Point2f>&trkPts){
-    Mat F;
-    vector<uchar> mask;
-    vector<Point2f>inlierRef, inlierTrk;
-    F = findFundamentalMat(refPts, trkPts, CV_RANSAC, 3.0, 0.99, mask);
-    for(size_t j=0; j<mask.size(); j++){
-        if(mask[j]==1){
-            inlierRef.emplace_back(refPts[j]);
-            inlierTrk.emplace_back(trkPts[j]);
-        }
+    if(refPts.size()<8){
+        return;
     }
-    refPts.clear(); trkPts.clear();
-    refPts = inlierRef; trkPts = inlierTrk;
+    findFundamentalMat(refPts, trkPts, CV_RANSAC, 3.0, 0.99, fmMask);
+    // no model, leave the points to PnP RANSAC
+    if(fmMask.size()!=refPts.size()){
+        return;
+    }
+    compactByMask(fmMask, refPts, trkPts);
 }
 
 
-void visualSLAM::PyrLKtrackFrame2Frame(Mat refimg, Mat curImg, vector<Point2f>refPts, vector<Point3f>ref3dpts,
-                                    vector<Point2f>&refRetpts, vector<Point3f>&ref3dretPts){
-    vector<Point2f> trackPts;
-    vector<uchar> Idx;
-    vector<float> err;
-
-    calcOpticalFlowPyrLK(refimg, curImg, refPts, trackPts,Idx, err);
+void visualSLAM::PyrLKtrackFrame2Frame(const vector<Mat>&refPyr, const vector<Mat>&curPyr, landmarkTable&lm,
+                                    const Mat&rvecPred, const Mat&tvecPred){
+    int flags = 0;
+    if(!rvecPred.empty()){
+        // start every point where the predicted pose puts its landmark, the
+        // ones that don't project keep zero flow
+        projectWithPose(lm.xyz, rvecPred, tvecPred, K, curPyr[0].size(), lm.uv, lkTrackPts, lkSeeded);
+        flags = OPTFLOW_USE_INITIAL_FLOW;
+    }
+    TermCriteria crit(TermCriteria::COUNT+TermCriteria::EPS, 30, 0.01);
+    calcOpticalFlowPyrLK(refPyr, curPyr, lm.uv, lkTrackPts, lkStatus, lkErr, lkWinSize, lkMaxLevel, crit, flags);
 
-    vector<Point2f> inlierRefPts, finalInlierRef;
-    vector<Point3f> inlierRef3dPts;
-    vector<Point2f> inlierTracked;
-    vector<int> res;
-    
-    // for(int j=0; j<refPts.size(); j++){
-    //     if(Idx[j]==1){
-    //         inlierRefPts.push_back(refPts[j]);
-    //         ref3dretPts.push_back(ref3dpts[j]);
-    //         refRetpts.push_back(trackPts[j]);
-    //     }
-    // }
-    for(int j=0; j<refPts.size(); j++){
-        if(Idx[j]==1){
-            inlierRefPts.push_back(refPts[j]);
-            inlierRef3dPts.push_back(ref3dpts[j]);
-            inlierTracked.push_back(trackPts[j]);
+    if(FB_CHECK_FLAG){
+        // track back from where each point landed, starting at its origin so
+        // good tracks converge in a couple of iterations
+        lkBackPts.assign(lm.uv.begin(), lm.uv.end());
+        calcOpticalFlowPyrLK(curPyr, refPyr, lkTrackPts, lkBackPts, lkBackStatus, lkErr, lkWinSize, lkMaxLevel, crit,
+                             OPTFLOW_USE_INITIAL_FLOW);
+        const float thr2 = fbThreshold*fbThreshold;
+        for(size_t j=0; j<lm.size(); j++){
+            Point2f d = lkBackPts[j] - lm.uv[j];
+            if(!lkBackStatus[j] || d.x*d.x + d.y*d.y > thr2){
+                lkStatus[j] = 0;
+            }
         }
     }
 
-    vector<uchar> inIdx;
-    Mat F = findFundamentalMat(inlierRefPts, inlierTracked,8,1.0,0.99,inIdx);
+    // the table is filtered in place, uv keeps the reference frame positions
+    // until the very end so the F matrix can see both sides
+    lm.compact(lkStatus);
+    compactByMask(lkStatus, lkTrackPts);
 
-    
-    for(int j=0; j<refPts.size(); j++){
-        if(inIdx[j]==1){
-            finalInlierRef.push_back(inlierRefPts[j]);
-            ref3dretPts.push_back(inlierRef3dPts[j]);
-            refRetpts.push_back(inlierTracked[j]);
+    if(FMAT_FLAG && lm.size()>=8){
+        findFundamentalMat(lm.uv, lkTrackPts, 8, 1.0, 0.99, fmMask);
+        // the mask only covers the LK survivors
+        if(fmMask.size()==lm.size()){
+            lm.compact(fmMask);
+            compactByMask(fmMask, lkTrackPts);
         }
     }
 
-    //refRetpts = inlierTracked;
-    //ref3dretPts = inlierRef3dPts;
-    refDrawPts = finalInlierRef; trackedDrawPts = refRetpts;
+    inlierReferencePyrLKPts.assign(lm.uv.begin(), lm.uv.end());
+    lm.uv.swap(lkTrackPts);
+    lm.markTracked();
 
-    inlierReferencePyrLKPts = finalInlierRef;
-}
\ No newline at end of file
+    refDrawPts.assign(inlierReferencePyrLKPts.begin(), inlierReferencePyrLKPts.end());
+    trackedDrawPts.assign(lm.uv.begin(), lm.uv.end());
+}
@@ -5,7 +5,10 @@ Mat visualSLAM::drawDepthCMap(Mat image, vector<Point3f>&pts3d, vector<Point2f>&
     int thresh = 30;
     double bias = 15;
     vector<uchar> mapping;
-    cvtColor(image, image, CV_BGR2GRAY); cvtColor(image, image, CV_GRAY2BGR);
+    if(image.channels()==3){
+        cvtColor(image, image, CV_BGR2GRAY);
+    }
+    cvtColor(image, image, CV_GRAY2BGR);
     //cerr<<"Starting cmapping"<<endl;
     
 
@@ -70,9 +73,20 @@ Mat visualSLAM::drawDepthCMap(Mat image, vector<Point3f>&pts3d, vector<Point2f>&
     return image;
 }
 
-void visualSLAM::stereoTriangulate(Mat im1, Mat im2, 
-                            vector<Point3f>&ref3dPts, 
-                            vector<Point2f>&ref2dPts){
+// new points closer than trackRadius to a live track would just duplicate it
+bool visualSLAM::nearTrack(const Point2f&p) const{
+    return trackIndex.anyWithin(p, (float)trackRadius);
+}
+
+// appends camera frame points of this stereo pair to lm. without keepTracks
+// the table is emptied first, with it only points away from the existing
+// tracks are matched and added
+void visualSLAM::stereoTriangulate(stereoFrame&frame, landmarkTable&lm, bool keepTracks){
+    // the prefetcher only decodes the left image, keyframes fetch the right
+    completeStereoPair(frame);
+    // matching runs on the luma planes, colour is only sampled at the
+    // triangulated points further down
+    Mat im1 = frame.grayL, im2 = frame.grayR;
     
     //Ptr<FeatureDetector> detector = xref2dFeatures2d::SIFT::create(1000);
     //Ptr<FeatureDetector> detector = ORB::create(4500);
@@ -84,83 +98,109 @@ void visualSLAM::stereoTriangulate(Mat im1, Mat im2,
     }
     vector<Point2f> pt1, pt2;
 
+    if(!keepTracks){
+        lm.clear();
+    }
+    trackIndex.setCellSize((float)std::max(1, trackRadius));
+    trackIndex.build(lm.uv);
+
     if(DENSE_FLAG){
-        vector<KeyPoint> dkps;
-        dkps = denseKeypointExtractor(im1, 30);
+        vector<Point2f> refPts;
+        if(BUCKET_FLAG){
+            featureService->bucketedKeypoints(im1, refPts, bucketConfig);
+        }
+        else{
+            vector<KeyPoint> dkps;
+            dkps = denseKeypointExtractor(im1, 30);
 
-        //FAST(im1, dkps, 2);
+            //FAST(im1, dkps, 2);
 
-        vector<Point2f> refPts;
-        for(size_t i=0; i<dkps.size(); i++){
-            refPts.emplace_back(dkps[i].pt);
+            for(size_t i=0; i<dkps.size(); i++){
+                refPts.emplace_back(dkps[i].pt);
+            }
+        }
+
+        // only fresh candidates go through stereo matching
+        if(!trackIndex.empty()){
+            triMask.resize(refPts.size());
+            for(size_t i=0; i<refPts.size(); i++){
+                triMask[i] = !nearTrack(refPts[i]);
+            }
+            compactByMask(triMask, refPts);
         }
 
         vector<Point2f> trkPts;
-        denseLKtracking(im1, im2, refPts, trkPts);
-        FmatThresholding(refPts, trkPts);
+        stereoEngine->match(frame.pyrL, frame.pyrR, im1.rows, refPts, trkPts);
 
         pt1 = refPts, pt2 = trkPts;
     }
     else{
-        Ptr<FeatureDetector> detector = ORB::create(1000);
-        vector<KeyPoint> kp1, kp2;
-        Mat desc1, desc2;
-
-        std::thread left([&](){
-            detector->detect(im1, kp1);
-            detector->compute(im1, kp1, desc1);
-        });
-        std::thread right([&](){    
-            detector->detect(im2, kp2);
-            detector->compute(im2, kp2, desc2);
-        });
-        left.join();
-        right.join();
-
-        desc1.convertTo(desc1, CV_32F);
-        desc2.convertTo(desc2, CV_32F);
-
-        BFMatcher matcher;
-        vector<vector<DMatch>> matches;
-        matcher.knnMatch(desc1, desc2, matches, 2);
-
-        for(int i=0; i<matches.size(); i++){
-            DMatch &m = matches[i][0]; DMatch &n = matches[i][1];
-            if(m.distance<0.8*n.distance){
-                pt1.emplace_back(kp1[m.queryIdx].pt);
-                pt2.emplace_back(kp2[m.trainIdx].pt);
+        featureService->matchStereo(im1, im2, pt1, pt2);
+        if(!trackIndex.empty()){
+            triMask.resize(pt1.size());
+            for(size_t i=0; i<pt1.size(); i++){
+                triMask[i] = !nearTrack(pt1[i]);
             }
+            compactByMask(triMask, pt1, pt2);
         }
     }
 
 
-    vector<Point3f> ref3dCoords, color3d;
+    vector<Point3f> ref3dCoords;
 
-    getColors(im1, pt1, color3d);
-    colors = color3d;
+    if(RECTIFIED_FLAG){
+        rectifiedRig rig = {(float)focal_x, (float)focal_y, (float)cx, (float)cy, (float)baseline};
+        triangulateRectified(rig, (const float*)pt1.data(), (const float*)pt2.data(), (int)pt1.size(), triBuffer);
 
-    Mat P1 = Mat::zeros(3,4, CV_64F);
-    Mat P2 = Mat::zeros(3,4, CV_64F);
-    P1.at<double>(0,0) = 1; P1.at<double>(1,1) = 1; P1.at<double>(2,2) = 1;
-    P2.at<double>(0,0) = 1; P2.at<double>(1,1) = 1; P2.at<double>(2,2) = 1;
-    P2.at<double>(0,3) = -baseline;
-
-    P1 = K*P1;
-    P2 = K*P2;
-
-    Mat est3d;
-    triangulatePoints(P1, P2, pt1, pt2, est3d);
+        // zero or negative disparity has no finite depth, drop it and keep pt1 aligned
+        triMask.resize(pt1.size());
+        for(size_t i=0; i<pt1.size(); i++){
+            const float z = triBuffer.z[i];
+            triMask[i] = z>0 && std::isfinite(z);
+        }
+        compactByMask(triMask, pt1, triBuffer.x, triBuffer.y, triBuffer.z);
+        ref3dCoords.reserve(pt1.size());
+        for(size_t i=0; i<pt1.size(); i++){
+            ref3dCoords.emplace_back(triBuffer.x[i], triBuffer.y[i], triBuffer.z[i]);
+        }
+    }
+    else{
+        Mat P1 = Mat::zeros(3,4, CV_64F);
+        Mat P2 = Mat::zeros(3,4, CV_64F);
+        P1.at<double>(0,0) = 1; P1.at<double>(1,1) = 1; P1.at<double>(2,2) = 1;
+        P2.at<double>(0,0) = 1; P2.at<double>(1,1) = 1; P2.at<double>(2,2) = 1;
+        P2.at<double>(0,3) = -baseline;
+
+        P1 = K*P1;
+        P2 = K*P2;
+
+        Mat est3d;
+        triangulatePoints(P1, P2, pt1, pt2, est3d);
+
+        for(int i=0; i<est3d.cols; i++){
+            Point3f localpt;
+            localpt.x = est3d.at<float>(0,i) / est3d.at<float>(3,i);
+            localpt.y = est3d.at<float>(1,i) / est3d.at<float>(3,i);
+            localpt.z = est3d.at<float>(2,i) / est3d.at<float>(3,i);
+            ref3dCoords.emplace_back(localpt);
+        }
+    }
 
-    for(int i=0; i<est3d.cols; i++){
-        Point3f localpt;
-        localpt.x = est3d.at<float>(0,i) / est3d.at<float>(3,i);
-        localpt.y = est3d.at<float>(1,i) / est3d.at<float>(3,i);
-        localpt.z = est3d.at<float>(2,i) / est3d.at<float>(3,i);
-        ref3dCoords.emplace_back(localpt);
+    // the index points into lm.uv, which the inserts below may reallocate
+    trackIndex.clear();
+    lm.reserve(lm.size() + pt1.size());
+    const bool colour = frame.imL.channels()==3;
+    for(size_t i=0; i<pt1.size(); i++){
+        const int x = int(pt1[i].x), y = int(pt1[i].y);
+        uint32_t c = 0;
+        if(colour){
+            const Vec3b &px = frame.imL.at<Vec3b>(y,x);
+            c = packRGB(px[2], px[1], px[0]);
+        }
+        else{
+            const uchar g = frame.imL.at<uchar>(y,x);
+            c = packRGB(g, g, g);
+        }
+        lm.add(ref3dCoords[i], pt1[i], c);
     }
-    
-    //drw = drawDepthCMap(im1, ref3dCoords, pt1);
-    //untransformed = ref3dCoords;
-    ref3dPts = ref3dCoords;
-    ref2dPts = pt1;
 }
\ No newline at end of file
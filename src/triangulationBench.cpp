@@ -0,0 +1,89 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "../include/stereoKernels.h"
+
+using namespace std;
+using namespace cv;
+
+// cv::triangulatePoints vs the closed form rectified kernel on the same
+// correspondences the dense tracker produces (20px lattice on a KITTI frame)
+int main(int argc, char **argv){
+    const int cols = 1241, rows = 376, step = 20;
+    const int reps = argc>1 ? atoi(argv[1]) : 200;
+
+    const double fx = 7.188560000000e+02, fy = 7.188560000000e+02;
+    const double cx = 6.071928000000e+02, cy = 1.852157000000e+02;
+    const double baseline = 0.54;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> depth(2.0f, 80.0f);
+
+    vector<Point2f> pt1, pt2;
+    for(int y=step; y<rows-step; y+=step){
+        for(int x=step; x<cols-step; x+=step){
+            float z = depth(rng);
+            pt1.emplace_back(x, y);
+            pt2.emplace_back(x - fx*baseline/z, y);
+        }
+    }
+    const int n = pt1.size();
+
+    Mat K = (Mat1d(3,3) << fx, 0, cx, 0, fy, cy, 0, 0, 1);
+    Mat P1 = Mat::zeros(3,4, CV_64F);
+    Mat P2 = Mat::zeros(3,4, CV_64F);
+    P1.at<double>(0,0) = 1; P1.at<double>(1,1) = 1; P1.at<double>(2,2) = 1;
+    P2.at<double>(0,0) = 1; P2.at<double>(1,1) = 1; P2.at<double>(2,2) = 1;
+    P2.at<double>(0,3) = -baseline;
+    P1 = K*P1; P2 = K*P2;
+
+    vector<Point3f> ref3d;
+    auto t0 = chrono::high_resolution_clock::now();
+    for(int r=0; r<reps; r++){
+        Mat est3d;
+        triangulatePoints(P1, P2, pt1, pt2, est3d);
+        ref3d.clear();
+        for(int i=0; i<est3d.cols; i++){
+            Point3f localpt;
+            localpt.x = est3d.at<float>(0,i) / est3d.at<float>(3,i);
+            localpt.y = est3d.at<float>(1,i) / est3d.at<float>(3,i);
+            localpt.z = est3d.at<float>(2,i) / est3d.at<float>(3,i);
+            ref3d.emplace_back(localpt);
+        }
+    }
+    auto t1 = chrono::high_resolution_clock::now();
+
+    rectifiedRig rig = {(float)fx, (float)fy, (float)cx, (float)cy, (float)baseline};
+    soaPoints3f soa;
+    for(int r=0; r<reps; r++){
+        triangulateRectified(rig, (const float*)pt1.data(), (const float*)pt2.data(), n, soa);
+    }
+    auto t2 = chrono::high_resolution_clock::now();
+
+    double maxErr = 0;
+    for(int i=0; i<n; i++){
+        maxErr = std::max(maxErr, (double)std::fabs(ref3d[i].z - soa.z[i]));
+    }
+
+    double usCV = chrono::duration<double, std::micro>(t1-t0).count()/reps;
+    double usK = chrono::duration<double, std::micro>(t2-t1).count()/reps;
+    cout<<"points per frame      : "<<n<<endl;
+    cout<<"cv::triangulatePoints : "<<usCV<<" us/frame"<<endl;
+    cout<<"rectified ("<<stereoKernelISA()<<")  : "<<usK<<" us/frame"<<endl;
+    cout<<"speedup               : "<<usCV/usK<<"x"<<endl;
+    cout<<"max |dz|              : "<<maxErr<<" m"<<endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <opencv2/core.hpp>
+
+#include "../include/binaryVocabulary.h"
+
+using namespace std;
+using namespace cv;
+using namespace DBoW2;
+
+// transform throughput of the DBoW2 tree walk (one FORB::distance per child)
+// against the packed walk over the hamming kernels. without a vocabulary a
+// small random one (k=10, L=4) is trained first
+int main(int argc, char **argv){
+    const int n = argc>2 ? atoi(argv[2]) : 100000;
+    const int perImage = 1000;
+
+    binaryOrbVocabulary voc;
+    if(argc>1){
+        if(isBinaryVocabulary(argv[1])){
+            if(!voc.loadBinary(argv[1])){
+                return 1;
+            }
+        }
+        else{
+            try{
+                voc.load(argv[1]);
+            }
+            catch(const string &e){
+                cerr<<e<<endl;
+                return 1;
+            }
+        }
+    }
+    else{
+        cerr<<"Training a random k=10 L=4 vocabulary"<<endl;
+        theRNG().state = 42;
+        vector<vector<FORB::TDescriptor>> training(100);
+        for(auto &img : training){
+            Mat d(200, 32, CV_8U);
+            randu(d, 0, 256);
+            for(int r=0; r<d.rows; r++){
+                img.push_back(d.row(r));
+            }
+        }
+        voc.create(training, 10, 4, TF_IDF, L1_NORM);
+    }
+    // plain copy walks the tree the DBoW2 way
+    OrbVocabulary plain(voc);
+    if(!voc.packed() && !voc.pack()){
+        return 1;
+    }
+    cerr<<voc.size()<<" words, "<<voc.getDepthLevels()<<" levels, kernels : "<<hammingKernelISA()<<endl;
+
+    Mat all(n, 32, CV_8U);
+    randu(all, 0, 256);
+    vector<vector<FORB::TDescriptor>> images((n + perImage - 1)/perImage);
+    for(int i=0; i<n; i++){
+        images[i/perImage].push_back(all.row(i));
+    }
+
+    int mismatches = 0;
+    for(int i=0; i<n; i++){
+        if(plain.transform(images[i/perImage][i%perImage])!=voc.transform(images[i/perImage][i%perImage])){
+            mismatches++;
+        }
+    }
+
+    BowVector bow;
+    auto t0 = chrono::high_resolution_clock::now();
+    for(auto &img : images){
+        plain.transform(img, bow);
+    }
+    auto t1 = chrono::high_resolution_clock::now();
+    for(auto &img : images){
+        voc.transform(img, bow);
+    }
+    auto t2 = chrono::high_resolution_clock::now();
+
+    const double before = chrono::duration<double>(t1 - t0).count();
+    const double after = chrono::duration<double>(t2 - t1).count();
+    cerr<<n<<" descriptors"<<endl;
+    cerr<<"DBoW2 walk   : "<<n/before<<" descriptors/s"<<endl;
+    cerr<<"packed walk  : "<<n/after<<" descriptors/s ("<<before/after<<"x)"<<endl;
+    cerr<<"word mismatches : "<<mismatches<<endl;
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include <iostream>
+#include <chrono>
+#include <stdio.h>
+
+#include "../include/binaryVocabulary.h"
+
+using namespace std;
+using namespace DBoW2;
+
+static double msSince(const chrono::steady_clock::time_point &t0){
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+// one time conversion of a DBoW2 YAML vocabulary into the flat binary
+// format, then reloads the result and checks it quantizes like the original
+int main(int argc, char **argv){
+    if(argc<3){
+        cerr<<"usage : "<<argv[0]<<" <vocabulary.yml.gz> <out.bin>"<<endl;
+        cerr<<"   eg : "<<argv[0]<<" orb_voc00.yml.gz orb_voc00.bin"<<endl;
+        return 1;
+    }
+
+    binaryOrbVocabulary yml;
+    auto t0 = chrono::steady_clock::now();
+    try{
+        yml.load(argv[1]);
+    }
+    catch(const string &e){
+        cerr<<e<<endl;
+        return 1;
+    }
+    cerr<<"Loaded "<<argv[1]<<" in "<<msSince(t0)<<" ms"<<endl;
+    cerr<<yml<<endl;
+
+    if(!yml.saveBinary(argv[2])){
+        return 1;
+    }
+
+    binaryOrbVocabulary bin;
+    t0 = chrono::steady_clock::now();
+    if(!bin.loadBinary(argv[2])){
+        return 1;
+    }
+    cerr<<"Loaded "<<argv[2]<<" in "<<msSince(t0)<<" ms"<<endl;
+
+    // every word's own descriptor has to land on the same word and weight
+    if(bin.size()!=yml.size() || bin.getDepthLevels()!=yml.getDepthLevels()){
+        cerr<<"Word count or depth differs after conversion"<<endl;
+        return 1;
+    }
+    int mismatches = 0;
+    for(WordId w=0; w<yml.size(); w++){
+        const FORB::TDescriptor &d = yml.getWord(w);
+        if(bin.transform(d)!=yml.transform(d) || bin.getWordWeight(w)!=yml.getWordWeight(w)){
+            mismatches++;
+        }
+    }
+    if(mismatches){
+        cerr<<mismatches<<" of "<<yml.size()<<" words quantize differently"<<endl;
+        return 1;
+    }
+    cerr<<"Wrote "<<yml.size()<<" words to "<<argv[2]<<endl;
+    return 0;
+}
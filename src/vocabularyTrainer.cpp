@@ -0,0 +1,479 @@
+/*
+GAUTHAM-JS , FEB-2021;
+gauthamjs56@gmail.com
+PART OF ROS STERO SLAM, UNDER MIT LICENSE.
+*/
+
+#include "../include/vocabularyTrainer.h"
+
+#include <iostream>
+#include <random>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <opencv2/features2d.hpp>
+#include "opencv2/highgui/highgui.hpp"
+
+using namespace std;
+using namespace DBoW2;
+
+static const uint64_t descriptorStart = 64;
+
+orbFeatureWriter::~orbFeatureWriter(){
+    if(fp){
+        close();
+    }
+}
+
+bool orbFeatureWriter::open(const string &path){
+    fp = fopen(path.c_str(), "wb");
+    if(!fp){
+        cerr<<"Could not open feature file "<<path<<" for writing"<<endl;
+        return false;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ORB_FEATURE_MAGIC, 8);
+    header.version = ORB_FEATURE_VERSION;
+    offsets.assign(1, 0);
+
+    // placeholder, rewritten on close once the index offset is known
+    char pad[descriptorStart] = {0};
+    memcpy(pad, &header, sizeof(header));
+    return fwrite(pad, 1, sizeof(pad), fp)==sizeof(pad);
+}
+
+bool orbFeatureWriter::append(const cv::Mat &descriptors){
+    if(!fp){
+        return false;
+    }
+    if(!descriptors.empty()){
+        if(descriptors.type()!=CV_8U || descriptors.cols!=(int)sizeof(packedDescriptor)){
+            cerr<<"Expected "<<sizeof(packedDescriptor)<<" byte ORB descriptors"<<endl;
+            return false;
+        }
+        for(int r=0; r<descriptors.rows; r++){
+            if(fwrite(descriptors.ptr(r), 1, sizeof(packedDescriptor), fp)!=sizeof(packedDescriptor)){
+                cerr<<"Feature file write failed at image "<<offsets.size()-1<<endl;
+                return false;
+            }
+        }
+    }
+    header.nDescriptors += descriptors.rows;
+    offsets.push_back(header.nDescriptors);
+    return true;
+}
+
+bool orbFeatureWriter::close(){
+    if(!fp){
+        return false;
+    }
+    bool ok = true;
+    header.nImages = offsets.size() - 1;
+    header.indexOffset = descriptorStart + header.nDescriptors*sizeof(packedDescriptor);
+    ok &= fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), fp)==offsets.size();
+    ok &= fseek(fp, 0, SEEK_SET)==0;
+    ok &= fwrite(&header, sizeof(header), 1, fp)==1;
+    ok &= fclose(fp)==0;
+    fp = NULL;
+    return ok;
+}
+
+
+orbFeatureFile::~orbFeatureFile(){
+    close();
+}
+
+void orbFeatureFile::close(){
+    if(base){
+        munmap(base, mappedBytes);
+    }
+    base = NULL;
+    mappedBytes = 0;
+    desc = NULL;
+    offsets = NULL;
+    header = orbFeatureHeader();
+}
+
+bool orbFeatureFile::open(const string &path){
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd<0){
+        cerr<<"Could not open feature file "<<path<<endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st)!=0 || (size_t)st.st_size<descriptorStart){
+        ::close(fd);
+        return false;
+    }
+    mappedBytes = st.st_size;
+    void *ptr = mmap(NULL, mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(ptr==MAP_FAILED){
+        cerr<<"mmap failed on "<<path<<endl;
+        mappedBytes = 0;
+        return false;
+    }
+    base = (unsigned char*)ptr;
+    memcpy(&header, base, sizeof(header));
+
+    if(memcmp(header.magic, ORB_FEATURE_MAGIC, 8)!=0 || header.version!=ORB_FEATURE_VERSION ||
+       header.indexOffset!=descriptorStart + header.nDescriptors*sizeof(packedDescriptor) ||
+       header.indexOffset + (header.nImages + 1)*sizeof(uint64_t)>mappedBytes){
+        cerr<<path<<" is not a complete feature file"<<endl;
+        close();
+        return false;
+    }
+    desc = (const packedDescriptor*)(base + descriptorStart);
+    offsets = (const uint64_t*)(base + header.indexOffset);
+    return true;
+}
+
+bool extractOrbFeatures(const vector<string> &images, const string &featureFile, int nFeatures, threadPool &pool){
+    orbFeatureWriter out;
+    if(!out.open(featureFile)){
+        return false;
+    }
+    const size_t window = pool.size()*4;
+    for(size_t start=0; start<images.size(); start+=window){
+        const size_t end = std::min(images.size(), start + window);
+        vector<future<cv::Mat>> jobs;
+        for(size_t i=start; i<end; i++){
+            jobs.push_back(pool.enqueue([&images, i, nFeatures](){
+                cv::Mat img = cv::imread(images[i], cv::IMREAD_GRAYSCALE);
+                cv::Mat desc;
+                if(!img.data){
+                    cerr<<"Could not read "<<images[i]<<endl;
+                    return desc;
+                }
+                vector<cv::KeyPoint> keys;
+                cv::ORB::create(nFeatures)->detectAndCompute(img, cv::noArray(), keys, desc);
+                return desc;
+            }));
+        }
+        for(size_t j=0; j<jobs.size(); j++){
+            if(!out.append(jobs[j].get())){
+                return false;
+            }
+        }
+        if(start/window%25==0){
+            cerr<<"Extracted "<<end<<" / "<<images.size()<<" images"<<endl;
+        }
+    }
+    return out.close();
+}
+
+// fn(begin, end) over [0, n) in a few chunks per pool thread, inline without
+// a pool or when there are less than two grains of work. never called from
+// inside a pool task
+static void parallelFor(threadPool *pool, size_t n, const function<void(size_t, size_t)> &fn, size_t grain = 1024){
+    if(!pool || pool->size()<2 || n<2*grain){
+        fn(0, n);
+        return;
+    }
+    const size_t chunks = pool->size()*4;
+    const size_t step = (n + chunks - 1)/chunks;
+    vector<future<void>> jobs;
+    for(size_t b=0; b<n; b+=step){
+        const size_t e = std::min(n, b + step);
+        jobs.push_back(pool->enqueue([&fn, b, e](){ fn(b, e); }));
+    }
+    for(auto &j : jobs){
+        j.get();
+    }
+}
+
+// Splits the descriptors ids[0, n) of one node into at most k clusters, the
+// ids come back grouped by cluster. same steps as DBoW2's HKmeansStep :
+// k-means++ seeds weighted by distance, nearest center assignment, bitwise
+// majority medians, until no assignment changes. empty clusters are dropped.
+static void clusterNode(const packedDescriptor *D, uint32_t *ids, size_t n, int k, int maxIterations,
+                        uint64_t seed, threadPool *pool,
+                        vector<packedDescriptor> &centers, vector<size_t> &counts){
+    centers.clear();
+    counts.clear();
+    if(n<=(size_t)k){
+        for(size_t i=0; i<n; i++){
+            centers.push_back(D[ids[i]]);
+            counts.push_back(1);
+        }
+        return;
+    }
+
+    std::mt19937_64 rng(seed);
+    centers.push_back(D[ids[rng()%n]]);
+    vector<int> minDist(n);
+    parallelFor(pool, n, [&](size_t b, size_t e){
+        for(size_t i=b; i<e; i++){
+            minDist[i] = hammingDistance(D[ids[i]], centers[0]);
+        }
+    });
+    while(centers.size()<(size_t)k){
+        double total = 0;
+        for(size_t i=0; i<n; i++){
+            total += minDist[i];
+        }
+        // everything left sits on a center already
+        if(total<=0){
+            break;
+        }
+        const double cut = std::uniform_real_distribution<double>(0, total)(rng);
+        size_t pick = n - 1;
+        double acc = 0;
+        for(size_t i=0; i<n; i++){
+            acc += minDist[i];
+            if(acc>cut){
+                pick = i;
+                break;
+            }
+        }
+        centers.push_back(D[ids[pick]]);
+        const packedDescriptor c = centers.back();
+        parallelFor(pool, n, [&](size_t b, size_t e){
+            for(size_t i=b; i<e; i++){
+                minDist[i] = std::min(minDist[i], hammingDistance(D[ids[i]], c));
+            }
+        });
+    }
+
+    const int nc = centers.size();
+    vector<int> labels(n, -1);
+    mutex sumLock;
+    for(int it=0; ; it++){
+        std::atomic<size_t> changed(0);
+        parallelFor(pool, n, [&](size_t b, size_t e){
+            size_t local = 0;
+            for(size_t i=b; i<e; i++){
+                const int l = nearestHamming(D[ids[i]], centers.data(), nc);
+                if(l!=labels[i]){
+                    labels[i] = l;
+                    local++;
+                }
+            }
+            changed += local;
+        });
+        if(changed==0 || it==maxIterations){
+            break;
+        }
+
+        // per bit vote of every cluster, summed chunk by chunk
+        vector<int> votes(nc*256, 0), members(nc, 0);
+        parallelFor(pool, n, [&](size_t b, size_t e){
+            vector<int> v(nc*256, 0), m(nc, 0);
+            for(size_t i=b; i<e; i++){
+                const packedDescriptor &d = D[ids[i]];
+                int *row = &v[labels[i]*256];
+                m[labels[i]]++;
+                for(int w=0; w<4; w++){
+                    uint64_t bits = d[w];
+                    while(bits){
+                        row[w*64 + __builtin_ctzll(bits)]++;
+                        bits &= bits - 1;
+                    }
+                }
+            }
+            lock_guard<mutex> lk(sumLock);
+            for(size_t j=0; j<v.size(); j++){
+                votes[j] += v[j];
+            }
+            for(int c=0; c<nc; c++){
+                members[c] += m[c];
+            }
+        });
+        for(int c=0; c<nc; c++){
+            if(members[c]==0){
+                continue;
+            }
+            // FORB::meanValue sets a bit when at least half the members have it
+            const int half = (members[c] + 1)/2;
+            packedDescriptor m = {{0, 0, 0, 0}};
+            for(int bit=0; bit<256; bit++){
+                if(votes[c*256 + bit]>=half){
+                    m[bit/64] |= 1ull<<(bit%64);
+                }
+            }
+            centers[c] = m;
+        }
+    }
+
+    // group the ids by cluster
+    vector<size_t> start(nc + 1, 0);
+    for(size_t i=0; i<n; i++){
+        start[labels[i] + 1]++;
+    }
+    for(int c=0; c<nc; c++){
+        start[c + 1] += start[c];
+    }
+    vector<uint32_t> grouped(n);
+    vector<size_t> cursor(start.begin(), start.end() - 1);
+    for(size_t i=0; i<n; i++){
+        grouped[cursor[labels[i]]++] = ids[i];
+    }
+    std::copy(grouped.begin(), grouped.end(), ids);
+
+    vector<packedDescriptor> kept;
+    for(int c=0; c<nc; c++){
+        if(start[c + 1]>start[c]){
+            kept.push_back(centers[c]);
+            counts.push_back(start[c + 1] - start[c]);
+        }
+    }
+    centers.swap(kept);
+}
+
+vocabularyTrainer::vocabularyTrainer(int k, int L, WeightingType weighting, ScoringType scoring){
+    m_k = k;
+    m_L = L;
+    m_weighting = weighting;
+    m_scoring = scoring;
+    createScoringObject();
+}
+
+bool vocabularyTrainer::train(const orbFeatureFile &features, threadPool &pool){
+    const packedDescriptor *D = features.descriptors();
+    const size_t N = features.size();
+    if(N==0){
+        cerr<<"No training descriptors"<<endl;
+        return false;
+    }
+    if(N>=UINT32_MAX){
+        cerr<<"Too many training descriptors ("<<N<<")"<<endl;
+        return false;
+    }
+
+    // tree under construction, node 0 is the root and has no descriptor
+    vector<packedDescriptor> nodeDesc(1);
+    vector<uint32_t> parent(1, 0);
+    vector<vector<uint32_t>> children(1);
+
+    struct nodeSpan{
+        uint32_t node;
+        size_t begin, end;
+    };
+    vector<uint32_t> ids(N);
+    for(size_t i=0; i<N; i++){
+        ids[i] = i;
+    }
+    vector<nodeSpan> level(1, nodeSpan{0, 0, N});
+
+    for(int l=1; l<=m_L && !level.empty(); l++){
+        vector<vector<packedDescriptor>> centers(level.size());
+        vector<vector<size_t>> counts(level.size());
+        auto cluster = [&](size_t s, threadPool *inner){
+            const nodeSpan &sp = level[s];
+            clusterNode(D, &ids[sp.begin], sp.end - sp.begin, m_k, maxIterations,
+                        (uint64_t)sp.node*0x9E3779B97F4A7C15ull + l, inner, centers[s], counts[s]);
+        };
+        // big nodes one after the other with the pool inside, the rest as
+        // one task each
+        vector<future<void>> jobs;
+        for(size_t s=0; s<level.size(); s++){
+            if(level[s].end - level[s].begin>=parallelNodeSize){
+                cluster(s, &pool);
+            }
+            else{
+                jobs.push_back(pool.enqueue([&cluster, s](){ cluster(s, NULL); }));
+            }
+        }
+        for(auto &j : jobs){
+            j.get();
+        }
+
+        // children are numbered in level order, so ids don't depend on
+        // which task finished first
+        vector<nodeSpan> next;
+        for(size_t s=0; s<level.size(); s++){
+            size_t begin = level[s].begin;
+            for(size_t c=0; c<centers[s].size(); c++){
+                const uint32_t id = nodeDesc.size();
+                nodeDesc.push_back(centers[s][c]);
+                parent.push_back(level[s].node);
+                children[level[s].node].push_back(id);
+                children.emplace_back();
+                // like HKmeansStep, a child with a single descriptor is a
+                // leaf and is not split again
+                if(counts[s][c]>1){
+                    next.push_back(nodeSpan{id, begin, begin + counts[s][c]});
+                }
+                begin += counts[s][c];
+            }
+        }
+        level.swap(next);
+        cerr<<"Level "<<l<<" : "<<level.size()<<" nodes"<<endl;
+    }
+
+    const size_t nNodes = nodeDesc.size();
+    nodeDescriptors.create((int)nNodes, sizeof(packedDescriptor), CV_8U);
+    memcpy(nodeDescriptors.data, nodeDesc.data(), nNodes*sizeof(packedDescriptor));
+
+    m_nodes.clear();
+    m_words.clear();
+    m_nodes.resize(nNodes);
+    for(size_t i=0; i<nNodes; i++){
+        Node &n = m_nodes[i];
+        n.id = i;
+        n.parent = parent[i];
+        n.children.assign(children[i].begin(), children[i].end());
+        n.weight = 0;
+        n.word_id = 0;
+        if(i>0){
+            n.descriptor = nodeDescriptors.row(i);
+        }
+    }
+    // leaves in node order, like DBoW2's createWords
+    for(size_t i=1; i<nNodes; i++){
+        if(m_nodes[i].isLeaf()){
+            m_nodes[i].word_id = m_words.size();
+            m_words.push_back(&m_nodes[i]);
+        }
+    }
+    if(!pack()){
+        return false;
+    }
+    setWeights(features, pool);
+    return pack();
+}
+
+// DBoW2 setNodeWeights : idf is log(images / images containing the word),
+// every training descriptor goes down the tree once
+void vocabularyTrainer::setWeights(const orbFeatureFile &features, threadPool &pool){
+    const size_t nWords = m_words.size();
+    if(m_weighting==TF || m_weighting==BINARY){
+        for(Node *w : m_words){
+            w->weight = 1;
+        }
+        return;
+    }
+
+    const int nImages = features.images();
+    const packedDescriptor *D = features.descriptors();
+    vector<uint32_t> Ni(nWords, 0);
+    mutex sumLock;
+    parallelFor(&pool, nImages, [&](size_t b, size_t e){
+        vector<uint32_t> local(nWords, 0);
+        vector<int> seen(nWords, -1);
+        for(size_t img=b; img<e; img++){
+            for(size_t i=features.imageBegin(img); i<features.imageEnd(img); i++){
+                const WordId w = m_nodes[walk(D[i])].word_id;
+                if(seen[w]!=(int)img){
+                    seen[w] = img;
+                    local[w]++;
+                }
+            }
+        }
+        lock_guard<mutex> lk(sumLock);
+        for(size_t w=0; w<nWords; w++){
+            Ni[w] += local[w];
+        }
+    }, 1);
+    for(size_t w=0; w<nWords; w++){
+        m_words[w]->weight = Ni[w]>0 ? std::log((double)nImages/(double)Ni[w]) : 0;
+    }
+}